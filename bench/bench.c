@@ -0,0 +1,343 @@
+// Micro-benchmark of the firmware hot paths on the native build.
+//
+// For every path it reports:
+//   host ns/call -- time spent by the machine running the benchmark,
+//                   useful to compare two versions of the code
+//   sim us/call  -- simulated time, which is what blocking delays
+//                   (OneWire, delayMicroseconds) cost on the device
+//   gpio/call    -- count of digitalWrite, digitalRead and pinMode calls,
+//                   each of them is a pin lookup in Sduino
+//
+// While loop() runs, it also measures how long each display segment
+// stays on: when on-time is uneven, so is brightness
+// (build with -DSEVSEG_TIMER to check interrupt driven refresh),
+// and how much of the time output is on, compared to duty cycle
+// it is set to (build with -DOutput_TIMER to check timer driven output),
+// and how much of the time core is awake, as average current
+// follows it (build with -DSCHEDULER_TIMER to sleep between iterations).
+// With -DSCHEDULER_PROFILE it prints counters the firmware keeps
+// for its profile menu after the loop run, as on the device.
+//
+// usage: bench [iterations [gpio cost in ns]]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <host.h>
+#include <Firmware.h>
+
+// same as ITERATION_DURATION in main.c
+#define BENCH_ITERATION_BUDGET 200
+
+typedef struct BenchResult
+{
+    uint32_t calls;
+    uint64_t hostNs;
+    uint64_t simNs;
+    uint64_t simNsMax;
+    uint64_t gpio;
+} BenchResult;
+
+// Returns simulated time which should not be counted
+// (conversion waits, sleep of the loop)
+typedef uint64_t (*BenchStep)(uint32_t i);
+
+static uint64_t hostClock(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static uint64_t gpioCalls(void)
+{
+    return (uint64_t)host_stats.digitalWrites + host_stats.digitalReads + host_stats.pinModes;
+}
+
+static void prepare(void)
+{
+    // background OneWire transaction of previous run must not stay
+    // busy forever, when its timer is reset
+    host_advanceNs(20000000);
+    uint32_t digitalWriteCost = host_cost.digitalWrite;
+    host_reset();
+    host_cost.digitalWrite = host_cost.digitalRead = host_cost.pinMode = digitalWriteCost;
+    host_ds18b20_attach(tempSensorPin);
+    host_ds18b20_setRaw(25 * 16);
+    setup();
+}
+
+static BenchResult run(BenchStep step, uint32_t calls)
+{
+    BenchResult result = {calls, 0, 0, 0, 0};
+    uint64_t gpioStart = gpioCalls();
+    uint64_t hostStart = hostClock();
+    for (uint32_t i = 0; i < calls; i++)
+    {
+        uint64_t before = host_ns;
+        uint64_t excluded = step(i);
+        uint64_t took = host_ns - before - excluded;
+        result.simNs += took;
+        if (took > result.simNsMax)
+            result.simNsMax = took;
+    }
+    result.hostNs = hostClock() - hostStart;
+    result.gpio = gpioCalls() - gpioStart;
+    return result;
+}
+
+static void report(const char *name, BenchResult *result)
+{
+    printf("%-24s %10u %12.1f %12.2f %12.2f %10.2f\n",
+           name, result->calls,
+           (double)result->hostNs / result->calls,
+           (double)result->simNs / result->calls / 1000,
+           (double)result->simNsMax / 1000,
+           (double)result->gpio / result->calls);
+}
+
+static uint64_t stepRefresh(uint32_t i)
+{
+    (void)i;
+    sevseg_refreshDisplay(&display);
+    return 0;
+}
+
+// Press and release button, so both debounce branches are taken
+static uint64_t stepButton(uint32_t i)
+{
+    host_setInput(buttonUpPin, (i / 64) & 1 ? LOW : HIGH);
+#ifdef Button_INTERRUPT
+    // edges are taken by interrupt, debounce takes time
+    host_advanceNs(200000);
+    readButtonEvents();
+    return 200000;
+#else
+    readButton(&buttonUp);
+    return 0;
+#endif
+}
+
+// Flashing temperature setting menu, the heaviest menu state,
+// counter runs down so number and blank take turns
+static uint64_t stepMenu(uint32_t i)
+{
+    menuState = 12; // MenuState_SET_HIGH
+    menuActiveCounter = 75 - i % 74;
+    displayMenu_dispatcher();
+    return 0;
+}
+
+// New temperature every call, whole range shown (-40.0 to 100.0)
+static uint64_t stepNumber(uint32_t i)
+{
+    displayNumber((int16_t)(i * 7 % 1401) - 400, false);
+    return 0;
+}
+
+static uint64_t stepTemperature(uint32_t i)
+{
+    // loop() calls it every 50 ms, it reads after conversion
+    host_advanceNs(50000000);
+    host_ds18b20_setRaw(20 * 16 + (i & 0x3F));
+    updateTemperature();
+    return 50000000;
+}
+
+// Every other temperature update is followed by corrupted read,
+// as on a long noisy cable (build with -Dnanods_CRC to check
+// that it is rejected)
+static uint32_t badTemperatures;
+
+static void runNoisyTemperature(uint32_t seconds)
+{
+    uint32_t end = millis() + seconds * 1000;
+    uint32_t reads = 0;
+    while (millis() < end)
+    {
+        int16_t prev = tempUpdatePrev;
+        loop();
+        if (tempUpdatePrev == prev)
+            continue;
+        // sensor stays at 25 degrees set by prepare
+        if (tempUpdatePrev != 250)
+            badTemperatures++;
+        host_ds18b20_setNoise(++reads & 1);
+    }
+}
+
+static uint32_t loopOverruns;
+
+static uint64_t segmentOnSince[HOST_PINS];
+static uint64_t segmentOnMin, segmentOnMax, segmentOnTotal;
+static uint32_t segmentOnCount;
+
+static uint64_t outputOnSince, outputOnTotal;
+
+static void trackSegment(uint8_t pin, uint8_t level)
+{
+    if (pin == outputPin)
+    {
+        if (level == output.onLevel)
+            outputOnSince = host_ns;
+        else if (outputOnSince)
+            outputOnTotal += host_ns - outputOnSince;
+        if (level != output.onLevel)
+            outputOnSince = 0;
+        return;
+    }
+
+    for (uint8_t segmentNum = 0; segmentNum < NUM_SEGMENTS; segmentNum++)
+    {
+        if (display.segmentPins[segmentNum] != pin)
+            continue;
+        if (level == SEGMENT_ON_VAL)
+        {
+            segmentOnSince[pin] = host_ns;
+        }
+        else if (segmentOnSince[pin])
+        {
+            uint64_t onTime = host_ns - segmentOnSince[pin];
+            segmentOnSince[pin] = 0;
+            if (!segmentOnCount || onTime < segmentOnMin)
+                segmentOnMin = onTime;
+            if (onTime > segmentOnMax)
+                segmentOnMax = onTime;
+            segmentOnTotal += onTime;
+            segmentOnCount++;
+        }
+    }
+}
+
+// Busy time of iteration, without sleep at its start
+static uint64_t stepLoop(uint32_t i)
+{
+    (void)i;
+    uint64_t before = host_ns;
+    loop();
+    uint64_t busyUs = micros() - scheduler.tickStart;
+    if (busyUs > BENCH_ITERATION_BUDGET)
+        loopOverruns++;
+    return host_ns - before - busyUs * 1000;
+}
+
+#ifdef SCHEDULER_PROFILE
+static const char *taskName(SchedulerCallback callback)
+{
+    if (callback == task_refreshDisplay)
+        return "task_refreshDisplay";
+    if (callback == task_input)
+        return "task_input";
+    if (callback == task_temperature)
+        return "task_temperature";
+#ifndef Button_INTERRUPT
+    if (callback == task_buttonHold)
+        return "task_buttonHold";
+#endif
+    if (callback == task_menuDecay)
+        return "task_menuDecay";
+#ifndef Output_TIMER
+    if (callback == task_output)
+        return "task_output";
+#endif
+#ifdef Telemetry_UART
+    if (callback == task_telemetry)
+        return "task_telemetry";
+#endif
+#ifdef Modbus_RTU
+    if (callback == task_modbus)
+        return "task_modbus";
+#endif
+    return "?";
+}
+
+static void reportProfile(const char *name, const ProfileCounter *counter)
+{
+    printf("%-24s %10u %12u %12u %12u\n", name, counter->count,
+           counter->count ? counter->min : 0, profile_average(counter), counter->max);
+}
+
+static void reportProfiles(void)
+{
+    printf("\n%-24s %10s %12s %12s %12s\n", "profile", "count", "min us", "avg us", "max us");
+    for (uint8_t taskNum = 0; taskNum < scheduler.numTasks; taskNum++)
+        reportProfile(taskName(scheduler.tasks[taskNum].callback), &scheduler.tasks[taskNum].profile);
+    reportProfile("busy", &scheduler.busy);
+    reportProfile("OneWire", &profileOneWire);
+}
+#endif
+
+int main(int argc, char **argv)
+{
+    uint32_t iterations = argc > 1 ? strtoul(argv[1], NULL, 10) : 2000000;
+    host_cost.digitalWrite = argc > 2 ? strtoul(argv[2], NULL, 10) : 0;
+
+    printf("%-24s %10s %12s %12s %12s %10s\n",
+           "path", "calls", "host ns/call", "sim us/call", "sim us max", "gpio/call");
+
+    BenchResult result;
+
+    prepare();
+    result = run(stepRefresh, iterations);
+    report("sevseg_refreshDisplay", &result);
+
+    prepare();
+    result = run(stepButton, iterations);
+    report("readButton", &result);
+
+    prepare();
+    result = run(stepMenu, iterations);
+    report("displayMenu_dispatcher", &result);
+
+    prepare();
+    result = run(stepNumber, iterations);
+    report("displayNumber", &result);
+
+    // every call of it takes simulated milliseconds
+    prepare();
+    result = run(stepTemperature, iterations / 1000 + 1);
+    report("updateTemperature", &result);
+
+    prepare();
+    badTemperatures = 0;
+    runNoisyTemperature(iterations / 5000 + 1);
+
+    prepare();
+    loopOverruns = 0;
+    host_onPinChange = trackSegment;
+    // measure output over whole cycles only, from the first one
+    while (output.step != output.period - 1)
+        stepLoop(0);
+    uint64_t outputStart = host_ns;
+    uint64_t sleepStart = host_stats.sleepNs;
+    outputOnTotal = 0;
+    if (outputOnSince)
+        outputOnSince = outputStart;
+    result = run(stepLoop, iterations);
+    while (output.step != output.period - 1)
+        stepLoop(0);
+    if (outputOnSince)
+        outputOnTotal += host_ns - outputOnSince;
+    uint64_t outputTime = host_ns - outputStart;
+    uint64_t sleepTime = host_stats.sleepNs - sleepStart;
+    host_onPinChange = NULL;
+    report("loop", &result);
+    printf("\nbad temperatures applied from noisy sensor: %u\n", badTemperatures);
+    printf("loop iterations over %d us budget: %u of %u, ticks missed: %u\n",
+           BENCH_ITERATION_BUDGET, loopOverruns, iterations, scheduler.overruns);
+    if (segmentOnCount)
+        printf("segment on time: min %.1f us, avg %.1f us, max %.1f us\n",
+               segmentOnMin / 1000.0,
+               (double)segmentOnTotal / segmentOnCount / 1000,
+               segmentOnMax / 1000.0);
+    printf("core awake: %.1f %% of time\n", 100.0 - 100.0 * sleepTime / outputTime);
+    printf("output duty: set %.2f %%, measured %.2f %% over %.1f s\n",
+           100.0 * output.high / output.period,
+           100.0 * outputOnTotal / outputTime,
+           outputTime / 1e9);
+#ifdef SCHEDULER_PROFILE
+    reportProfiles();
+#endif
+
+    return 0;
+}
@@ -0,0 +1,125 @@
+// Stress test of EventRing with threads standing in for interrupt
+// (producer) and main loop (consumer).
+//
+// Every event carries its sequence number (source and value)
+// and a check byte (type), consumer verifies that events come
+// complete, in order, and none is lost or repeated:
+//   blocking -- producer waits while ring is full, all events must come
+//   dropping -- producer gives up on full ring, like an interrupt does,
+//               events received and dropped must add up
+// and reports throughput of both.
+//
+// usage: eventring [events]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+#include <EventRing.h>
+
+typedef struct StressRun
+{
+    EventRing ring;
+    uint32_t count;
+    bool blocking;
+    uint32_t dropped;  // by producer
+    bool produced;     // producer is done
+    uint32_t received; // by consumer
+    uint32_t errors;
+} StressRun;
+
+static uint8_t checkByte(uint32_t seq)
+{
+    return (uint8_t)(seq ^ (seq >> 8) ^ (seq >> 16) ^ 0x5A);
+}
+
+static void *produce(void *arg)
+{
+    StressRun *run = arg;
+    for (uint32_t seq = 0; seq < run->count; seq++)
+    {
+        while (!eventring_push(&run->ring, checkByte(seq), (uint8_t)(seq >> 16), (int16_t)seq))
+        {
+            if (!run->blocking)
+            {
+                run->dropped++;
+                break;
+            }
+            sched_yield();
+        }
+        // interrupt comes in bursts, consumer runs between them
+        if (!run->blocking && (seq & 7) == 7)
+            sched_yield();
+    }
+    __atomic_store_n(&run->produced, true, __ATOMIC_SEQ_CST);
+    return NULL;
+}
+
+static void *consume(void *arg)
+{
+    StressRun *run = arg;
+    uint32_t expected = 0;
+    Event event;
+    while (expected < run->count)
+    {
+        if (!eventring_pop(&run->ring, &event))
+        {
+            // with drops the last events may never come
+            if (__atomic_load_n(&run->produced, __ATOMIC_SEQ_CST) && !eventring_count(&run->ring))
+                break;
+            sched_yield();
+            continue;
+        }
+
+        // sequence is 24 bit, events newer than it can't be in the ring
+        uint32_t seq = ((uint32_t)event.source << 16) | (uint16_t)event.value;
+        seq |= expected & 0xFF000000;
+        if (event.type != checkByte(seq) || seq < expected || (run->blocking && seq != expected))
+            run->errors++;
+        expected = seq + 1;
+        run->received++;
+    }
+    return NULL;
+}
+
+static double stress(uint32_t count, bool blocking)
+{
+    static StressRun run;
+    run.count = count;
+    run.blocking = blocking;
+    run.dropped = run.received = run.errors = 0;
+    run.produced = false;
+    eventring_begin(&run.ring);
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    pthread_t producer, consumer;
+    pthread_create(&consumer, NULL, consume, &run);
+    pthread_create(&producer, NULL, produce, &run);
+    pthread_join(producer, NULL);
+    pthread_join(consumer, NULL);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+
+    // blocking producer retries, so the ring counts drops it has not made,
+    // its counter is 8 bit
+    bool ok = !run.errors && run.received + run.dropped == count &&
+              (blocking ? !run.dropped : (uint8_t)run.dropped == run.ring.dropped);
+    printf("%-9s %10u sent %10u received %10u dropped %6u errors  %7.1f M/s  %s\n",
+           blocking ? "blocking" : "dropping", count, run.received, run.dropped, run.errors,
+           run.received / seconds / 1e6, ok ? "ok" : "FAILED");
+    return ok;
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t count = argc > 1 ? strtoul(argv[1], NULL, 10) : 10000000;
+    if (count > 0xFFFFFF)
+        count = 0xFFFFFF;
+
+    printf("ring of %d events, %u bytes\n", EVENTRING_SIZE, (unsigned)sizeof(EventRing));
+    bool ok = stress(count, true);
+    ok = stress(count, false) && ok;
+    return !ok;
+}
@@ -0,0 +1,92 @@
+// Benchmark entry of the STM8 firmware, run under ucsim_stm8
+// by bench/ucsim.py (see stm8sblue_ucsim in platformio.ini).
+//
+// Its main() is linked in place of the one of Sduino, which comes
+// from the core library only while main is missing. After setup()
+// of the firmware it calls the hot paths over and over, each call
+// right after an empty mark function named after the path.
+// The runner stops on every mark, so cycles from one stop to
+// the next are the cost of the call after the mark (with the cost
+// of the mark itself, which is measured with bench_overhead
+// and taken away).
+//
+// Whole loop() iterations are measured with the tick already due,
+// so the scheduler does not spin, and what is counted is the busy
+// part of the iteration (and one micros() call to make the tick
+// due). No sensor answers on the pin, so updateTemperature takes
+// its no-device path, which still blocks for the reset pulse.
+// TIM4 interrupt of millis() comes in between, as it does
+// on the device.
+
+#include <Firmware.h>
+
+#define BENCH_REPEAT 64
+#define BENCH_LOOPS 1000 // covers every phase of the tasks
+
+void bench_overhead(void) {}
+void bench_refreshDisplay(void) {}
+#ifndef SEVSEG_NOFLOAT
+void bench_setNumberF(void) {}
+#endif
+void bench_setNumber16(void) {}
+void bench_updateTemperature(void) {}
+#ifndef Button_INTERRUPT
+void bench_readButton(void) {}
+#endif
+void bench_loop(void) {}
+void bench_done(void) {}
+
+void main(void)
+{
+    init();
+    setup();
+
+    uint16_t i;
+    for (i = 0; i < BENCH_REPEAT; i++)
+        bench_overhead();
+
+    for (i = 0; i < BENCH_REPEAT; i++)
+    {
+        bench_refreshDisplay();
+        sevseg_refreshDisplay(&display);
+    }
+
+    // whole range of temperatures, -40.0 to 100.0
+#ifndef SEVSEG_NOFLOAT
+    for (i = 0; i < BENCH_REPEAT; i++)
+    {
+        bench_setNumberF();
+        sevseg_setNumberF(&display, (int16_t)(i * 229 % 1401 - 400) / 10.0f, 1);
+    }
+#endif
+    for (i = 0; i < BENCH_REPEAT; i++)
+    {
+        bench_setNumber16();
+        sevseg_setNumber16(&display, (int16_t)(i * 229 % 1401 - 400), 1);
+    }
+
+    for (i = 0; i < BENCH_REPEAT; i++)
+    {
+        bench_updateTemperature();
+        updateTemperature();
+    }
+
+#ifndef Button_INTERRUPT
+    for (i = 0; i < BENCH_REPEAT; i++)
+    {
+        bench_readButton();
+        readButton(&buttonUp);
+    }
+#endif
+
+    for (i = 0; i < BENCH_LOOPS; i++)
+    {
+        scheduler.nextTick = micros();
+        bench_loop();
+        loop();
+    }
+
+    bench_done();
+    for (;;)
+        ;
+}
@@ -0,0 +1,195 @@
+# Cycle counts of the STM8 firmware under ucsim_stm8 (from SDCC).
+#
+# Runs the image built with bench/ucsim.c (env stm8sblue_ucsim),
+# stops on every bench_* mark function of it and takes the cycles
+# ucsim reports between stops: the interval after a stop on
+# bench_NAME is one call of NAME (minus cost of an empty mark,
+# measured by bench_overhead). Addresses of marks are read from
+# the linker map (or NoICE file) next to the image.
+#
+# Fails if any path takes longer than its budget: ITERATION_DURATION
+# (200 us at 16 MHz) for the ones that never wait, BLOCKING_US for
+# updateTemperature and loop(), which wait out OneWire time slots
+# (unless built with nanods_ASYNC).
+#
+# No sensor answers in the simulator, so updateTemperature (and loop()
+# iterations which run it) is measured on its no-device path: reset
+# pulse only. A real read also clocks out the scratchpad, see BLOCKING_US.
+#
+# usage: python bench/ucsim.py firmware.ihx
+# or as extra script: pio run -e stm8sblue_ucsim -t ucsim
+# UCSIM environment variable overrides the simulator command,
+# which is ucsim_stm8, or sstm8 of SDCC when that is missing.
+
+import os
+import pty
+import re
+import select
+import shlex
+import shutil
+import subprocess
+import sys
+import time
+
+F_CPU = 16000000
+ITERATION_DURATION_US = 200  # same as in src/main.c
+# longest OneWire transaction is scratchpad read with CRC, ~5 ms
+BLOCKING_US = 6000
+BUDGETS_US = {"updateTemperature": BLOCKING_US, "loop": BLOCKING_US}
+UCSIM = "ucsim_stm8 -t STM8S103 -X 16M"
+UCSIM_SDCC = "sstm8 -t STM8S103 -X 16M"
+TIMEOUT_S = 600  # for one run, from a stop to the next
+
+
+def mark_addresses(image):
+    base = os.path.splitext(image)[0]
+    patterns = [
+        (base + ".noi", r"DEF\s+_(bench_\w+)\s+0x([0-9A-Fa-f]+)"),
+        (base + ".map", r"\b([0-9A-Fa-f]{4,8})\s+_(bench_\w+)\b"),
+    ]
+    for path, pattern in patterns:
+        if not os.path.exists(path):
+            continue
+        marks = {}
+        with open(path) as f:
+            for match in re.finditer(pattern, f.read()):
+                name, address = match.groups()
+                if path.endswith(".map"):
+                    address, name = name, address
+                marks[int(address, 16)] = name[len("bench_"):]
+        if marks:
+            return marks
+    sys.exit("no bench_* symbols next to %s, is it built with bench/ucsim.c?" % image)
+
+
+def ucsim_command():
+    if "UCSIM" in os.environ:
+        return shlex.split(os.environ["UCSIM"])
+    for command in (UCSIM, UCSIM_SDCC):
+        if shutil.which(command.split()[0]):
+            return shlex.split(command)
+    sys.exit("neither ucsim_stm8 nor sstm8 found, set UCSIM")
+
+
+def lines(output, process):
+    # a run which never reaches a mark would block a plain read forever
+    deadline = time.time() + TIMEOUT_S
+    buffer = b""
+    while True:
+        left = deadline - time.time()
+        if left <= 0 or not select.select([output], [], [], left)[0]:
+            process.kill()
+            sys.exit("ucsim has not stopped in %d s" % TIMEOUT_S)
+        try:
+            chunk = os.read(output, 4096)
+        except OSError:  # pty gives EIO when ucsim is gone
+            return
+        if not chunk:
+            return
+        buffer += chunk
+        while b"\n" in buffer:
+            line, buffer = buffer.split(b"\n", 1)
+            yield line.decode("ascii", "replace")
+
+
+def run_ucsim(image, marks):
+    commands = ["break 0x%x" % address for address in marks]
+    # one run per stop, until bench_done; every stop is answered
+    # by the next run, so the simulator never runs past the end
+    stops = []
+    # on a terminal ucsim writes every line at once
+    master, slave = pty.openpty()
+    process = subprocess.Popen(
+        ucsim_command() + [image],
+        stdin=subprocess.PIPE,
+        stdout=slave,
+        stderr=slave,
+        universal_newlines=True,
+    )
+    os.close(slave)
+    for command in commands:
+        process.stdin.write(command + "\n")
+
+    address = None
+    while True:
+        process.stdin.write("run\n")
+        process.stdin.flush()
+        address = None
+        for line in lines(master, process):
+            match = re.search(r"Stop at 0x([0-9A-Fa-f]+)", line)
+            if match:
+                address = int(match.group(1), 16)
+            match = re.search(r"Simulated\s+(\d+)\s+ticks", line)
+            if match:
+                break
+        else:
+            sys.exit("ucsim exited before bench_done")
+        if address not in marks:
+            sys.exit("ucsim stopped outside of marks at 0x%x" % (address or 0))
+        stops.append((marks[address], int(match.group(1))))
+        if marks[address] == "done":
+            break
+
+    process.stdin.write("quit\n")
+    process.stdin.close()
+    process.wait(TIMEOUT_S)
+    os.close(master)
+    return stops
+
+
+def report(stops):
+    # ticks of a run belong to the mark where the previous run stopped
+    paths = {}
+    order = []
+    for (name, _), (_, ticks) in zip(stops, stops[1:]):
+        if name not in paths:
+            paths[name] = []
+            order.append(name)
+        paths[name].append(ticks)
+
+    overhead = min(paths.pop("overhead", [0]))
+    order = [name for name in order if name != "overhead"]
+    print("%-24s %8s %10s %10s %10s %10s %10s" % (
+        "path", "calls", "min", "avg", "max", "max us", "budget us"))
+    failed = []
+    for name in order:
+        cycles = [ticks - overhead for ticks in paths[name]]
+        worst = max(cycles)
+        budget = BUDGETS_US.get(name, ITERATION_DURATION_US)
+        print("%-24s %8d %10d %10.1f %10d %10.1f %10d" % (
+            name, len(cycles), min(cycles), sum(cycles) / float(len(cycles)),
+            worst, worst * 1000000.0 / F_CPU, budget))
+        if worst > budget * F_CPU // 1000000:
+            failed.append(name)
+    print("\nmark overhead %d cycles" % overhead)
+    print("updateTemperature and loop are on the no-device path, without a read")
+    if failed:
+        print("over budget: %s" % ", ".join(failed))
+        return 1
+    print("ok")
+    return 0
+
+
+def main(image):
+    marks = mark_addresses(image)
+    return report(run_ucsim(image, marks))
+
+
+try:
+    Import("env")  # noqa: F821, run by PlatformIO
+
+    def ucsim_action(target, source, env):
+        return main(str(source[0]))
+
+    env.AddCustomTarget(  # noqa: F821
+        name="ucsim",
+        dependencies="$BUILD_DIR/${PROGNAME}.ihx",
+        actions=ucsim_action,
+        title="ucsim",
+        description="Cycle counts of hot paths under ucsim_stm8",
+    )
+except NameError:
+    if __name__ == "__main__":
+        if len(sys.argv) != 2:
+            sys.exit("usage: %s firmware.ihx" % sys.argv[0])
+        sys.exit(main(sys.argv[1]))
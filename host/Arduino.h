@@ -0,0 +1,60 @@
+// Minimal Sduino API replacement for building the firmware on Linux.
+//
+// Only what src/main.c and libraries from lib/ use is provided.
+// All calls go to host.c, which keeps simulated clock,
+// pin states and statistics (see host.h).
+
+#ifndef Arduino_h
+#define Arduino_h
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stm8s.h>
+
+#define F_CPU 16000000UL
+
+#define HIGH 0x1
+#define LOW 0x0
+
+#define INPUT 0x00
+#define INPUT_PULLUP 0x40
+#define OUTPUT 0xe0     // push-pull
+#define OUTPUT_OD 0xa0  // open drain
+#define OUTPUT_FAST 0xf0
+
+#define NOT_A_PORT 0
+#define PA 1
+#define PB 2
+#define PC 3
+#define PD 4
+
+#define digitalPinToPort(P) host_pinPort(P)
+#define digitalPinToBitMask(P) host_pinMask(P)
+#define portOutputRegister(P) (&host_gpio[(P) - 1].ODR)
+
+#define min(a, b) ((a) < (b) ? (a) : (b))
+#define max(a, b) ((a) > (b) ? (a) : (b))
+#define constrain(amt, low, high) ((amt) < (low) ? (low) : ((amt) > (high) ? (high) : (amt)))
+
+// NOP_MICROSECOND in nanoOneWire.h assumes 8 nops per microsecond
+#define nop() host_nop()
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t val);
+int digitalRead(uint8_t pin);
+
+uint32_t millis(void);
+uint32_t micros(void);
+void delay(uint32_t ms);
+void delayMicroseconds(uint32_t us);
+
+#define interrupts() host_interrupts(true)
+#define noInterrupts() host_interrupts(false)
+
+uint8_t host_pinPort(uint8_t pin);
+uint8_t host_pinMask(uint8_t pin);
+void host_nop(void);
+void host_interrupts(bool enabled);
+
+#endif
@@ -0,0 +1,33 @@
+// Sduino EEPROM macros on top of host_eeprom array
+// (640 bytes like stm8s103, erased state is 0x00).
+
+#ifndef EEPROM_h
+#define EEPROM_h
+
+#include <stdint.h>
+#include <string.h>
+
+#define EEPROM_SIZE 640
+
+extern uint8_t host_eeprom[EEPROM_SIZE];
+
+void host_eepromWrite(uint16_t idx, const void *data, uint16_t size);
+
+#define EEPROM_read(idx) (host_eeprom[(idx)])
+#define EEPROM_write(idx, val)         \
+    do                                 \
+    {                                  \
+        uint8_t _v = (val);            \
+        host_eepromWrite(idx, &_v, 1); \
+    } while (0)
+#define EEPROM_update(idx, val)              \
+    do                                       \
+    {                                        \
+        if (EEPROM_read(idx) != (uint8_t)(val)) \
+            EEPROM_write(idx, val);          \
+    } while (0)
+
+#define EEPROM_get(idx, T) memcpy(&(T), &host_eeprom[(idx)], sizeof(T))
+#define EEPROM_put(idx, T) host_eepromWrite(idx, &(T), sizeof(T))
+
+#endif
@@ -0,0 +1,514 @@
+#include <host.h>
+#include <EEPROM.h>
+
+uint64_t host_ns;
+HostStats host_stats;
+HostCost host_cost;
+
+void (*host_onPinChange)(uint8_t pin, uint8_t level);
+void (*host_onUartTx)(uint8_t byte);
+
+uint8_t host_eeprom[EEPROM_SIZE];
+GPIO_TypeDef host_gpio[HOST_PORTS];
+TIM1_TypeDef host_tim1;
+TIM2_TypeDef host_tim2;
+EXTI_TypeDef host_exti;
+UART1_TypeDef host_uart1;
+
+// Pin numbers of stm8sblue board in Sduino
+static const uint8_t pinPorts[HOST_PINS] = {
+    PA, PA, PA, PB, PB, PC, PC, PC, PC, PC, PD, PD, PD, PD, PD, PD};
+static const uint8_t pinBits[HOST_PINS] = {
+    1, 2, 3, 5, 4, 3, 4, 5, 6, 7, 1, 2, 3, 4, 5, 6};
+
+// Handlers firmware does not define
+__attribute__((weak)) void TIM1_UPD_OVF_TRG_BRK_IRQHandler(void) {}
+__attribute__((weak)) void TIM2_UPD_OVF_BRK_IRQHandler(void) {}
+__attribute__((weak)) void EXTI_PORTA_IRQHandler(void) {}
+__attribute__((weak)) void EXTI_PORTB_IRQHandler(void) {}
+__attribute__((weak)) void EXTI_PORTC_IRQHandler(void) {}
+__attribute__((weak)) void EXTI_PORTD_IRQHandler(void) {}
+__attribute__((weak)) void UART1_TX_IRQHandler(void) {}
+__attribute__((weak)) void UART1_RX_IRQHandler(void) {}
+
+static void (*const extiHandlers[HOST_PORTS])(void) = {
+    EXTI_PORTA_IRQHandler, EXTI_PORTB_IRQHandler,
+    EXTI_PORTC_IRQHandler, EXTI_PORTD_IRQHandler};
+
+typedef struct HostTimer
+{
+    uint64_t (*period)(void); // in ns, zero when interrupt disabled
+    void (*handler)(void);
+    uint64_t next;
+} HostTimer;
+
+static uint64_t tim1Period(void)
+{
+    if (!(TIM1->CR1 & TIM1_CR1_CEN) || !(TIM1->IER & TIM1_IER_UIE))
+        return 0;
+    uint32_t arr = ((uint32_t)TIM1->ARRH << 8) | TIM1->ARRL;
+    uint32_t prescaler = ((uint32_t)TIM1->PSCRH << 8) | TIM1->PSCRL;
+    return (uint64_t)(arr + 1) * (prescaler + 1) * 1000000000 / F_CPU;
+}
+
+static void tim1Update(void)
+{
+    TIM1->SR1 |= TIM1_SR1_UIF;
+    TIM1_UPD_OVF_TRG_BRK_IRQHandler();
+}
+
+// Counter of running TIM1 follows simulated time
+// (from its phase at zero, which is good for differences)
+static void syncTim1Counter(void)
+{
+    if (!(TIM1->CR1 & TIM1_CR1_CEN))
+        return;
+    uint32_t arr = ((uint32_t)TIM1->ARRH << 8) | TIM1->ARRL;
+    uint32_t prescaler = ((uint32_t)TIM1->PSCRH << 8) | TIM1->PSCRL;
+    uint64_t ticks = host_ns * (F_CPU / 1000000) / 1000 / (prescaler + 1);
+    uint16_t counter = ticks % (arr + 1);
+    TIM1->CNTRH = counter >> 8;
+    TIM1->CNTRL = counter & 0xFF;
+}
+
+static uint64_t tim2Period(void)
+{
+    if (!(TIM2->CR1 & TIM2_CR1_CEN) || !(TIM2->IER & TIM2_IER_UIE))
+        return 0;
+    uint32_t arr = ((uint32_t)TIM2->ARRH << 8) | TIM2->ARRL;
+    return ((uint64_t)(arr + 1) << (TIM2->PSCR & 0x0F)) * 1000000000 / F_CPU;
+}
+
+static void tim2Update(void)
+{
+    TIM2->SR1 |= TIM2_SR1_UIF;
+    TIM2_UPD_OVF_BRK_IRQHandler();
+}
+
+// UART1 transmitter: byte written to DR waits there (TXE clear)
+// while the previous one is shifted out, 10 bits with 8N1
+static bool uartShifting;
+static uint8_t uartShiftByte;
+
+static void syncUart(void);
+
+static uint64_t uartCharNs(void)
+{
+    uint32_t divider = ((uint32_t)(UART1->BRR2 & 0xF0) << 8) | ((uint32_t)UART1->BRR1 << 4) | (UART1->BRR2 & 0x0F);
+    return (uint64_t)(divider ? divider : 16) * 10 * 1000000000 / F_CPU;
+}
+
+static uint64_t uartPeriod(void)
+{
+    return uartShifting && (UART1->CR2 & UART1_CR2_TEN) ? uartCharNs() : 0;
+}
+
+// Data register empty or transmission complete
+static bool uartTxInterrupt(void)
+{
+    return ((UART1->CR2 & UART1_CR2_TIEN) && (UART1->SR & UART1_SR_TXE)) ||
+           ((UART1->CR2 & UART1_CR2_TCIEN) && (UART1->SR & UART1_SR_TC));
+}
+
+// Shift register is empty: byte is sent, the next one starts
+static void uartUpdate(void)
+{
+    uartShifting = false;
+    UART1->SR |= UART1_SR_TC;
+    if (host_onUartTx)
+        host_onUartTx(uartShiftByte);
+    syncUart();
+    if (uartTxInterrupt())
+    {
+        UART1_TX_IRQHandler();
+        syncUart();
+    }
+}
+
+// Receiver takes a byte every character time, while there are any
+#define HOST_UART_RX_MAX 512
+static uint8_t uartRx[HOST_UART_RX_MAX];
+static uint16_t uartRxFirst, uartRxCount;
+
+static uint64_t uartRxPeriod(void)
+{
+    return uartRxCount ? uartCharNs() : 0;
+}
+
+// Stop bit of the byte came, handler reads data register,
+// which clears RXNE
+static void uartRxUpdate(void)
+{
+    uint8_t byte = uartRx[uartRxFirst];
+    uartRxFirst = (uartRxFirst + 1) % HOST_UART_RX_MAX;
+    uartRxCount--;
+    if (!(UART1->CR2 & UART1_CR2_REN) || UART1->DR != HOST_UART_EMPTY)
+    {
+        host_stats.uartRxLost++;
+        return;
+    }
+    UART1->DR = HOST_UART_RECEIVED | byte;
+    UART1->SR |= UART1_SR_RXNE;
+    if (UART1->CR2 & UART1_CR2_RIEN)
+        UART1_RX_IRQHandler();
+    UART1->SR &= (uint8_t)~UART1_SR_RXNE;
+    UART1->DR = HOST_UART_EMPTY;
+}
+
+static HostTimer timers[] = {
+    {tim1Period, tim1Update, 0},
+    {tim2Period, tim2Update, 0},
+    {uartPeriod, uartUpdate, 0},
+    {uartRxPeriod, uartRxUpdate, 0},
+};
+#define TIMERS_COUNT (sizeof(timers) / sizeof(timers[0]))
+#define UART_TIMER (&timers[2])
+
+static bool interruptsEnabled;
+static bool inInterrupt;
+
+static uint8_t pinModes[HOST_PINS];
+static uint8_t pinInputs[HOST_PINS];
+static uint8_t dsPin = 0xFF;
+static uint8_t syncedOutputs[HOST_PORTS];
+static uint8_t pendingExti; // bit for every port
+
+static void fireExti(void);
+static void fireUart(void);
+
+static void syncPorts(void);
+
+void host_reset(void)
+{
+    host_ns = 0;
+    memset(&host_stats, 0, sizeof(host_stats));
+    memset(host_eeprom, 0, sizeof(host_eeprom));
+    for (uint8_t pin = 0; pin < HOST_PINS; pin++)
+    {
+        pinModes[pin] = INPUT;
+        pinInputs[pin] = HIGH;
+    }
+    memset(host_gpio, 0, sizeof(host_gpio));
+    for (uint8_t port = 0; port < HOST_PORTS; port++)
+        host_gpio[port].IDR = 0xFF;
+    memset(&host_exti, 0, sizeof(host_exti));
+    pendingExti = 0;
+    memset(syncedOutputs, 0, sizeof(syncedOutputs));
+    dsPin = 0xFF;
+    host_ds18b20_reset();
+    host_plant_detach();
+    host_onPinChange = NULL;
+    memset(&host_tim1, 0, sizeof(host_tim1));
+    memset(&host_tim2, 0, sizeof(host_tim2));
+    memset(&host_uart1, 0, sizeof(host_uart1));
+    UART1->SR = UART1_SR_TXE | UART1_SR_TC;
+    UART1->DR = HOST_UART_EMPTY;
+    uartShifting = false;
+    uartRxFirst = uartRxCount = 0;
+    host_onUartTx = NULL;
+    for (uint8_t i = 0; i < TIMERS_COUNT; i++)
+        timers[i].next = 0;
+    interruptsEnabled = true;
+    inInterrupt = false;
+}
+
+// Fire timer interrupts which are due within ns,
+// time spent in handlers delays the caller
+void host_advanceNs(uint64_t ns)
+{
+    uint64_t until = host_ns + ns;
+    syncPorts();
+    fireExti();
+    fireUart();
+    while (interruptsEnabled && !inInterrupt)
+    {
+        HostTimer *due = NULL;
+        for (uint8_t i = 0; i < TIMERS_COUNT; i++)
+        {
+            uint64_t period = timers[i].period();
+            if (!period)
+            {
+                timers[i].next = 0;
+                continue;
+            }
+            if (!timers[i].next)
+                timers[i].next = host_ns + period;
+            if (timers[i].next <= until && (!due || timers[i].next < due->next))
+                due = &timers[i];
+        }
+        if (!due)
+            break;
+
+        uint64_t start = host_ns = due->next;
+        due->next += due->period();
+        inInterrupt = true;
+        due->handler();
+        syncPorts();
+        syncUart();
+        inInterrupt = false;
+        until += host_ns - start;
+    }
+    host_ns = until;
+    syncTim1Counter();
+    host_plant_advance();
+}
+
+void loop(); // of the firmware
+
+void host_runFor(uint32_t ms)
+{
+    uint32_t end = millis() + ms;
+    while (millis() < end)
+        loop();
+}
+
+void host_interrupts(bool enabled)
+{
+    interruptsEnabled = enabled;
+    fireExti();
+    fireUart();
+}
+
+// Move byte written to DR to the shift register, if it is free
+static void syncUart(void)
+{
+    if (UART1->DR >= HOST_UART_EMPTY)
+        return;
+    if (!(UART1->CR2 & UART1_CR2_TEN))
+    {
+        UART1->DR = HOST_UART_EMPTY;
+        return;
+    }
+    if (uartShifting)
+    {
+        UART1->SR &= (uint8_t)~UART1_SR_TXE;
+        return;
+    }
+    uartShiftByte = (uint8_t)UART1->DR;
+    UART1->DR = HOST_UART_EMPTY;
+    UART1->SR = (UART1->SR | UART1_SR_TXE) & (uint8_t)~UART1_SR_TC;
+    uartShifting = true;
+    UART_TIMER->next = host_ns + uartCharNs();
+}
+
+// Run TX handler while it has room to write, unless interrupts are disabled
+static void fireUart(void)
+{
+    syncUart();
+    while (interruptsEnabled && !inInterrupt && uartTxInterrupt())
+    {
+        inInterrupt = true;
+        UART1_TX_IRQHandler();
+        syncUart();
+        inInterrupt = false;
+    }
+}
+
+// Run handlers of ports which had edges, unless interrupts are disabled
+static void fireExti(void)
+{
+    if (!interruptsEnabled || inInterrupt)
+        return;
+    for (uint8_t port = 0; port < HOST_PORTS; port++)
+    {
+        if (!(pendingExti & (1 << port)))
+            continue;
+        pendingExti &= ~(1 << port);
+        inInterrupt = true;
+        extiHandlers[port]();
+        inInterrupt = false;
+    }
+}
+
+// Only timers wake the core, it never wakes without them
+// (millis() of Sduino is not simulated with interrupt)
+void host_wfi(void)
+{
+    interruptsEnabled = true;
+    uint64_t wake = 0;
+    for (uint8_t i = 0; i < TIMERS_COUNT; i++)
+    {
+        uint64_t period = timers[i].period();
+        if (!period)
+            continue;
+        uint64_t next = timers[i].next ? timers[i].next : host_ns + period;
+        if (!wake || next < wake)
+            wake = next;
+    }
+    // interrupt may be already due, if it was disabled
+    uint64_t sleep = wake > host_ns ? wake - host_ns : 0;
+    host_stats.sleepNs += sleep;
+    host_advanceNs(sleep);
+}
+
+void host_uartReceive(const uint8_t *data, uint16_t size)
+{
+    for (uint16_t i = 0; i < size && uartRxCount < HOST_UART_RX_MAX; i++)
+        uartRx[(uartRxFirst + uartRxCount++) % HOST_UART_RX_MAX] = data[i];
+}
+
+// Edge on input with interrupt enabled (CR2) fires EXTI of its port,
+// sensitivity of the port is 0 or 2 falling, 1 rising, 3 both
+void host_setInput(uint8_t pin, uint8_t level)
+{
+    if (pinInputs[pin] == level)
+        return;
+    pinInputs[pin] = level;
+
+    uint8_t port = pinPorts[pin] - 1;
+    uint8_t mask = host_pinMask(pin);
+    if (level == HIGH)
+        host_gpio[port].IDR |= mask;
+    else
+        host_gpio[port].IDR &= ~mask;
+
+    uint8_t sensitivity = (host_exti.CR1 >> (port * 2)) & 3;
+    bool input = pinModes[pin] == INPUT || pinModes[pin] == INPUT_PULLUP;
+    bool sensitive = (level == HIGH) ? (sensitivity & 1) : (sensitivity != 1);
+    if (input && (host_gpio[port].CR2 & mask) && sensitive)
+    {
+        pendingExti |= 1 << port;
+        fireExti();
+    }
+}
+
+uint8_t host_pinPort(uint8_t pin)
+{
+    return pin < HOST_PINS ? pinPorts[pin] : NOT_A_PORT;
+}
+
+uint8_t host_pinMask(uint8_t pin)
+{
+    return pin < HOST_PINS ? 1 << pinBits[pin] : 0;
+}
+
+static uint8_t outputLevel(uint8_t pin)
+{
+    return (*portOutputRegister(pinPorts[pin]) & host_pinMask(pin)) ? HIGH : LOW;
+}
+
+uint8_t host_getOutput(uint8_t pin)
+{
+    return outputLevel(pin);
+}
+
+uint8_t host_getMode(uint8_t pin)
+{
+    return pinModes[pin];
+}
+
+void host_ds18b20_attach(uint8_t pin)
+{
+    dsPin = pin;
+}
+
+// Report pins changed since last call, both by digitalWrite
+// and by writes to ODR registers
+static void syncPorts(void)
+{
+    uint8_t port = 0;
+    while (port < HOST_PORTS && host_gpio[port].ODR == syncedOutputs[port])
+        port++;
+    if (port == HOST_PORTS)
+        return;
+
+    for (uint8_t pin = 0; pin < HOST_PINS; pin++)
+    {
+        port = pinPorts[pin] - 1;
+        uint8_t mask = host_pinMask(pin);
+        uint8_t changed = (host_gpio[port].ODR ^ syncedOutputs[port]) & mask;
+        if (!changed)
+            continue;
+        syncedOutputs[port] ^= changed;
+        host_plant_pinChanged(pin, outputLevel(pin));
+        if (host_onPinChange)
+            host_onPinChange(pin, outputLevel(pin));
+    }
+}
+
+static bool drivenLow(uint8_t pin)
+{
+    return pinModes[pin] != INPUT && pinModes[pin] != INPUT_PULLUP && outputLevel(pin) == LOW;
+}
+
+// Notify sensor only on actual edges of the line
+static void setPin(uint8_t pin, uint8_t mode, uint8_t level)
+{
+    volatile uint8_t *out = portOutputRegister(pinPorts[pin]);
+    bool wasLow = drivenLow(pin);
+    pinModes[pin] = mode;
+    if (level == HIGH)
+        *out |= host_pinMask(pin);
+    else
+        *out &= ~host_pinMask(pin);
+    syncPorts();
+    if (pin == dsPin && wasLow != drivenLow(pin))
+        host_ds18b20_lineChanged(!wasLow);
+}
+
+void pinMode(uint8_t pin, uint8_t mode)
+{
+    host_stats.pinModes++;
+    host_ns += host_cost.pinMode;
+    syncTim1Counter();
+    if (pin < HOST_PINS)
+        setPin(pin, mode, outputLevel(pin));
+}
+
+void digitalWrite(uint8_t pin, uint8_t val)
+{
+    host_stats.digitalWrites++;
+    host_ns += host_cost.digitalWrite;
+    syncTim1Counter();
+    if (pin < HOST_PINS)
+        setPin(pin, pinModes[pin], val ? HIGH : LOW);
+}
+
+int digitalRead(uint8_t pin)
+{
+    host_stats.digitalReads++;
+    host_ns += host_cost.digitalRead;
+    syncTim1Counter();
+    if (pin >= HOST_PINS)
+        return LOW;
+    if (pin == dsPin)
+        return (drivenLow(pin) || host_ds18b20_pullsLow()) ? LOW : HIGH;
+    if (pinModes[pin] == INPUT || pinModes[pin] == INPUT_PULLUP)
+        return pinInputs[pin];
+    return outputLevel(pin);
+}
+
+uint32_t millis(void)
+{
+    return (uint32_t)(host_ns / 1000000);
+}
+
+uint32_t micros(void)
+{
+    return (uint32_t)(host_ns / 1000);
+}
+
+void delay(uint32_t ms)
+{
+    host_advanceNs((uint64_t)ms * 1000000);
+}
+
+void delayMicroseconds(uint32_t us)
+{
+    host_advanceNs((uint64_t)us * 1000);
+}
+
+// 16 MHz core, but one nop is taken as 1/8 us,
+// same as NOP_MICROSECOND assumes
+void host_nop(void)
+{
+    host_advanceNs(125);
+}
+
+void host_eepromWrite(uint16_t idx, const void *data, uint16_t size)
+{
+    if (idx + size > EEPROM_SIZE)
+        return;
+    memcpy(&host_eeprom[idx], data, size);
+    host_stats.eepromWrites += size;
+}
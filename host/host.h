@@ -0,0 +1,104 @@
+// Host side of the Sduino replacement: everything
+// benchmark and simulation harnesses can poke at.
+//
+// Time is simulated: it advances only in delays, nops
+// and per call costs from host_cost, so results do not
+// depend on the speed of the machine running the build.
+// Timer interrupts (see stm8s.h) fire when simulated
+// time passes their period.
+
+#ifndef host_h
+#define host_h
+
+#include <Arduino.h>
+
+#define HOST_PINS 16
+
+typedef struct HostStats
+{
+    uint32_t digitalWrites;
+    uint32_t digitalReads;
+    uint32_t pinModes;
+    uint32_t eepromWrites; // bytes
+    uint64_t sleepNs;      // spent in wfi()
+    uint32_t uartRxLost;   // bytes came while receiver was off
+    uint64_t plantOnNs;    // time plant output was on
+} HostStats;
+
+// Simulated duration of Sduino calls (in nanoseconds),
+// zero by default
+typedef struct HostCost
+{
+    uint32_t digitalWrite;
+    uint32_t digitalRead;
+    uint32_t pinMode;
+} HostCost;
+
+extern uint64_t host_ns;
+extern HostStats host_stats;
+extern HostCost host_cost;
+
+// Called when output level of any pin changes
+extern void (*host_onPinChange)(uint8_t pin, uint8_t level);
+// Called when UART1 has sent a byte (after its stop bit)
+extern void (*host_onUartTx)(uint8_t byte);
+
+// Reset clock, pins, statistics, EEPROM and sensor
+void host_reset(void);
+void host_advanceNs(uint64_t ns);
+// Run loop() of the firmware for ms of simulated time
+void host_runFor(uint32_t ms);
+
+// Level which external circuit sets on input pin
+// (HIGH by default, as buttons are pulled up)
+void host_setInput(uint8_t pin, uint8_t level);
+uint8_t host_getOutput(uint8_t pin);
+uint8_t host_getMode(uint8_t pin);
+
+// Bytes coming to UART1 receiver, one every character time
+// from now on (after bytes queued before)
+void host_uartReceive(const uint8_t *data, uint16_t size);
+
+#define HOST_DS18B20_MAX 4
+
+// Simulated DS18B20 on given pin
+void host_ds18b20_attach(uint8_t pin);
+// How many sensors share the pin, 1 by default
+void host_ds18b20_setCount(uint8_t count);
+// Temperature in sixteenths of degree (raw DS18B20 format),
+// of all sensors or of one of them
+void host_ds18b20_setRaw(int16_t raw);
+void host_ds18b20_setSensorRaw(uint8_t index, int16_t raw);
+const uint8_t *host_ds18b20_rom(uint8_t index);
+// Flip a bit of temperature in the next 'reads' scratchpad reads
+void host_ds18b20_setNoise(uint8_t reads);
+
+// Heater and sensor in one vessel, see host_plant.c.
+// Temperatures in degrees, times in seconds.
+typedef struct HostPlant
+{
+    float ambient;
+    float gain; // rise over ambient at full power, negative for cooler
+    float timeConstant;
+    float deadTime; // from output to sensor, up to 120 s
+    float sensorLag; // time constant of sensor in its sheath, 0 for none
+    uint8_t pin;    // output driving the plant
+    uint8_t onLevel;
+} HostPlant;
+
+// Sensor temperature follows the plant from now on,
+// until host_reset or host_plant_detach
+void host_plant_attach(const HostPlant *plant, float temperature);
+void host_plant_detach(void);
+float host_plant_temperature(void);
+// Step of load, plant heads for the new ambient from now on
+void host_plant_setAmbient(float ambient);
+
+// Called by host.c, not meant for harnesses
+void host_plant_advance(void);
+void host_plant_pinChanged(uint8_t pin, uint8_t level);
+void host_ds18b20_reset(void);
+void host_ds18b20_lineChanged(bool low);
+bool host_ds18b20_pullsLow(void);
+
+#endif
@@ -0,0 +1,341 @@
+// DS18B20 simulated on the bit level.
+//
+// Sensor watches edges of the line and measures how long
+// master held it low, like the real one does.
+// Timing is checked loosely: it is here to verify
+// protocol, not margins of bit slots.
+//
+// Several sensors may share the line (see host_ds18b20_setCount),
+// each one runs its own state machine, and the line is low
+// when any of them pulls it down.
+
+#include <string.h>
+#include <host.h>
+
+#define DS_WAIT_RESET 0
+#define DS_ROM_COMMAND 1
+#define DS_FUNCTION_COMMAND 2
+#define DS_RECEIVE 3
+#define DS_TRANSMIT 4
+#define DS_CONVERTING 5
+#define DS_MATCH_ROM 6
+#define DS_SEARCH_ROM 7
+
+#define US 1000ULL
+#define RESET_MIN (400 * US)
+#define WRITE_ONE_MAX (15 * US)
+#define READ_ZERO_HOLD (30 * US)
+#define PRESENCE_START (30 * US)
+#define PRESENCE_END (150 * US)
+
+typedef struct HostSensor
+{
+    uint8_t state;
+    uint64_t holdLowUntil;
+
+    uint8_t rxByte;
+    uint8_t rxBits;
+    uint8_t rxLeft;
+
+    uint8_t txBuf[9];
+    uint8_t txBits;
+    uint8_t txPos;
+
+    uint8_t searchBit;   // Position in ROM code
+    uint8_t searchPhase; // Bit, complement, then master's choice
+
+    uint8_t rom[8];
+    uint8_t scratchpad[9];
+    int16_t currentRaw;
+    int16_t pendingRaw;
+    uint64_t conversionEnd;
+    bool conversionPending;
+} HostSensor;
+
+static HostSensor sensors[HOST_DS18B20_MAX];
+static uint8_t sensorsCount = 1;
+
+static uint8_t noisyReads;
+
+static uint64_t fallNs;
+static uint64_t presenceFrom;
+static uint64_t presenceUntil;
+
+static uint8_t crc8(const uint8_t *data, uint8_t len)
+{
+    uint8_t crc = 0;
+    while (len--)
+    {
+        uint8_t b = *data++;
+        for (uint8_t i = 8; i; i--)
+        {
+            uint8_t mix = (crc ^ b) & 1;
+            crc >>= 1;
+            if (mix)
+                crc ^= 0x8C;
+            b >>= 1;
+        }
+    }
+    return crc;
+}
+
+static uint8_t resolution(HostSensor *sensor)
+{
+    return 9 + ((sensor->scratchpad[4] >> 5) & 3);
+}
+
+static void finishConversion(HostSensor *sensor)
+{
+    if (!sensor->conversionPending || host_ns < sensor->conversionEnd)
+        return;
+    sensor->conversionPending = false;
+    // low bits are undefined on lower resolutions, sensor reports zeros
+    int16_t raw = sensor->pendingRaw & ~((1 << (12 - resolution(sensor))) - 1);
+    sensor->scratchpad[0] = raw & 0xFF;
+    sensor->scratchpad[1] = (raw >> 8) & 0xFF;
+}
+
+static void transmit(HostSensor *sensor, const uint8_t *data, uint8_t len)
+{
+    memcpy(sensor->txBuf, data, len);
+    sensor->txBits = len * 8;
+    sensor->txPos = 0;
+    sensor->state = DS_TRANSMIT;
+}
+
+static bool romBit(HostSensor *sensor)
+{
+    return sensor->rom[sensor->searchBit / 8] & (1 << (sensor->searchBit % 8));
+}
+
+static void receiveByte(HostSensor *sensor, uint8_t data)
+{
+    if (sensor->state == DS_ROM_COMMAND)
+    {
+        if (data == 0xCC) // SKIP ROM
+        {
+            sensor->state = DS_FUNCTION_COMMAND;
+        }
+        else if (data == 0x33) // READ ROM
+        {
+            transmit(sensor, sensor->rom, 8);
+        }
+        else if (data == 0x55) // MATCH ROM
+        {
+            sensor->rxLeft = 8;
+            sensor->state = DS_MATCH_ROM;
+        }
+        else if (data == 0xF0) // SEARCH ROM
+        {
+            sensor->searchBit = 0;
+            sensor->searchPhase = 0;
+            sensor->state = DS_SEARCH_ROM;
+        }
+        else
+        {
+            sensor->state = DS_WAIT_RESET;
+        }
+        return;
+    }
+
+    if (sensor->state == DS_MATCH_ROM)
+    {
+        if (data != sensor->rom[8 - sensor->rxLeft])
+            sensor->state = DS_WAIT_RESET;
+        else if (--sensor->rxLeft == 0)
+            sensor->state = DS_FUNCTION_COMMAND;
+        return;
+    }
+
+    if (sensor->state == DS_FUNCTION_COMMAND)
+    {
+        if (data == 0x44) // CONVERT T
+        {
+            // busy sensor keeps running conversion
+            static const uint16_t durationMs[] = {94, 188, 375, 750};
+            finishConversion(sensor);
+            if (!sensor->conversionPending)
+            {
+                sensor->pendingRaw = sensor->currentRaw;
+                sensor->conversionPending = true;
+                sensor->conversionEnd = host_ns + durationMs[resolution(sensor) - 9] * 1000 * US;
+            }
+            sensor->state = DS_CONVERTING;
+        }
+        else if (data == 0xBE) // READ SCRATCHPAD
+        {
+            finishConversion(sensor);
+            sensor->scratchpad[8] = crc8(sensor->scratchpad, 8);
+            transmit(sensor, sensor->scratchpad, 9);
+            if (noisyReads)
+            {
+                noisyReads--;
+                sensor->txBuf[0] ^= 0x10; // 1 degree off
+            }
+        }
+        else if (data == 0x4E) // WRITE SCRATCHPAD
+        {
+            sensor->rxLeft = 3;
+            sensor->state = DS_RECEIVE;
+        }
+        else
+        {
+            sensor->state = DS_WAIT_RESET;
+        }
+        return;
+    }
+
+    if (sensor->state == DS_RECEIVE)
+    {
+        // TH, TL, configuration register
+        sensor->scratchpad[5 - sensor->rxLeft] = data;
+        if (sensor->rxLeft == 1)
+            sensor->scratchpad[4] = (data & 0x60) | 0x1F;
+        if (--sensor->rxLeft == 0)
+            sensor->state = DS_WAIT_RESET;
+    }
+}
+
+static void resetSensor(HostSensor *sensor, uint8_t index)
+{
+    static const uint8_t scratchpad[9] = {0x50, 0x05, 0xFF, 0x00, 0x7F, 0xFF, 0x0C, 0x10, 0x00};
+    static const uint8_t rom[8] = {0x28, 0x41, 0x53, 0x54, 0x01, 0x00, 0x00};
+
+    memset(sensor, 0, sizeof(*sensor));
+    sensor->state = DS_WAIT_RESET;
+    memcpy(sensor->scratchpad, scratchpad, sizeof(scratchpad));
+    sensor->currentRaw = 0x0550; // 85 °C, power-on value
+
+    // codes differ in several bits, so search has to resolve conflicts
+    memcpy(sensor->rom, rom, sizeof(rom));
+    sensor->rom[1] ^= index * 0x25;
+    sensor->rom[4] += index;
+    sensor->rom[7] = crc8(sensor->rom, 7);
+}
+
+void host_ds18b20_reset(void)
+{
+    presenceFrom = presenceUntil = 0;
+    sensorsCount = 1;
+    noisyReads = 0;
+    for (uint8_t i = 0; i < HOST_DS18B20_MAX; i++)
+        resetSensor(&sensors[i], i);
+}
+
+void host_ds18b20_setCount(uint8_t count)
+{
+    sensorsCount = count < HOST_DS18B20_MAX ? count : HOST_DS18B20_MAX;
+}
+
+void host_ds18b20_setRaw(int16_t raw)
+{
+    for (uint8_t i = 0; i < HOST_DS18B20_MAX; i++)
+        sensors[i].currentRaw = raw;
+}
+
+void host_ds18b20_setSensorRaw(uint8_t index, int16_t raw)
+{
+    if (index < HOST_DS18B20_MAX)
+        sensors[index].currentRaw = raw;
+}
+
+void host_ds18b20_setNoise(uint8_t reads)
+{
+    noisyReads = reads;
+}
+
+const uint8_t *host_ds18b20_rom(uint8_t index)
+{
+    return sensors[index].rom;
+}
+
+static void lineFell(HostSensor *sensor)
+{
+    if (sensor->state == DS_TRANSMIT)
+    {
+        if (!(sensor->txBuf[sensor->txPos / 8] & (1 << (sensor->txPos % 8))))
+            sensor->holdLowUntil = host_ns + READ_ZERO_HOLD;
+        if (++sensor->txPos == sensor->txBits)
+            sensor->state = DS_WAIT_RESET;
+    }
+    else if (sensor->state == DS_CONVERTING)
+    {
+        finishConversion(sensor);
+        if (sensor->conversionPending)
+            sensor->holdLowUntil = host_ns + READ_ZERO_HOLD;
+    }
+    else if (sensor->state == DS_SEARCH_ROM)
+    {
+        // two read slots: bit of the code, then its complement
+        if (sensor->searchPhase < 2 && romBit(sensor) == sensor->searchPhase)
+            sensor->holdLowUntil = host_ns + READ_ZERO_HOLD;
+        sensor->searchPhase++;
+    }
+}
+
+static void lineRose(HostSensor *sensor, uint64_t lowFor)
+{
+    if (lowFor >= RESET_MIN)
+    {
+        finishConversion(sensor);
+        sensor->rxBits = 0;
+        sensor->state = DS_ROM_COMMAND;
+        return;
+    }
+
+    if (sensor->state == DS_SEARCH_ROM)
+    {
+        // write slot: sensor drops out if master chose the other way
+        if (sensor->searchPhase < 3)
+            return;
+        sensor->searchPhase = 0;
+        if ((lowFor < WRITE_ONE_MAX) != romBit(sensor))
+            sensor->state = DS_WAIT_RESET;
+        else if (++sensor->searchBit == 64)
+            sensor->state = DS_WAIT_RESET;
+        return;
+    }
+
+    if (sensor->state != DS_ROM_COMMAND && sensor->state != DS_FUNCTION_COMMAND &&
+        sensor->state != DS_RECEIVE && sensor->state != DS_MATCH_ROM)
+        return;
+
+    sensor->rxByte >>= 1;
+    if (lowFor < WRITE_ONE_MAX)
+        sensor->rxByte |= 0x80;
+    if (++sensor->rxBits == 8)
+    {
+        sensor->rxBits = 0;
+        receiveByte(sensor, sensor->rxByte);
+    }
+}
+
+void host_ds18b20_lineChanged(bool low)
+{
+    if (low)
+    {
+        fallNs = host_ns;
+        for (uint8_t i = 0; i < sensorsCount; i++)
+            lineFell(&sensors[i]);
+        return;
+    }
+
+    uint64_t lowFor = host_ns - fallNs;
+    if (lowFor >= RESET_MIN)
+    {
+        presenceFrom = host_ns + PRESENCE_START;
+        presenceUntil = host_ns + PRESENCE_END;
+    }
+    for (uint8_t i = 0; i < sensorsCount; i++)
+        lineRose(&sensors[i], lowFor);
+}
+
+bool host_ds18b20_pullsLow(void)
+{
+    if (host_ns >= presenceFrom && host_ns < presenceUntil)
+        return true;
+    for (uint8_t i = 0; i < sensorsCount; i++)
+        if (host_ns < sensors[i].holdLowUntil)
+            return true;
+    return false;
+}
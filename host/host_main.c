@@ -0,0 +1,56 @@
+// Entry point of native build: runs firmware against
+// simulated sensor and prints what display and output show.
+//
+// usage: program [seconds [temperature]]
+// temperature is in degrees, default is 25
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <host.h>
+#include <Firmware.h>
+
+// Turn segment codes back into text
+static void renderDisplay(char *out)
+{
+    static const uint8_t codes[] = {0x3F, 0x06, 0x5B, 0x4F, 0x66, 0x6D, 0x7D, 0x07, 0x7F, 0x6F, 0x00, 0x40};
+    static const char chars[] = "0123456789 -";
+    for (uint8_t digitNum = 0; digitNum < display.numDigits; digitNum++)
+    {
+        uint8_t code = display.blanked ? 0 : display.digitCodes[digitNum];
+        char c = '?';
+        for (uint8_t i = 0; i < sizeof(codes); i++)
+            if ((code & 0x7F) == codes[i])
+                c = chars[i];
+        *out++ = c;
+        if (code & 0x80)
+            *out++ = '.';
+    }
+    *out = 0;
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t seconds = argc > 1 ? atoi(argv[1]) : 10;
+    float temperature = argc > 2 ? atof(argv[2]) : 25;
+
+    host_reset();
+    host_ds18b20_attach(tempSensorPin);
+    host_ds18b20_setRaw((int16_t)(temperature * 16));
+
+    setup();
+    uint32_t nextReport = 0;
+    while (millis() < seconds * 1000)
+    {
+        loop();
+        if (millis() >= nextReport)
+        {
+            char text[MAXNUMDIGITS * 2 + 1];
+            renderDisplay(text);
+            printf("%6.1f s  display \"%s\"  output %s\n",
+                   millis() / 1000.0, text,
+                   host_getOutput(outputPin) == LOW ? "ON" : "OFF");
+            nextReport += 1000;
+        }
+    }
+    return 0;
+}
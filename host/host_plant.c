@@ -0,0 +1,117 @@
+// Thermal plant driven by output pin of the firmware.
+//
+// First order heater (or cooler, with negative gain):
+// temperature approaches ambient + gain * power with
+// time constant, and sensor sees it with dead time,
+// through first order lag of its sheath.
+// Power is the share of the last step output was on,
+// which is the average of what SlowPWM sets.
+// Sensor reading is rounded to sixteenths of degree, as DS18B20
+// does, before host_ds18b20.c cuts it to the resolution set.
+// On time of the output goes to host_stats.
+
+#include <string.h>
+#include <host.h>
+
+#define PLANT_STEP_NS 100000000ULL // 100 ms
+#define PLANT_DELAY_MAX 1200       // 120 s of dead time
+
+static HostPlant plant;
+static bool attached;
+static float temperature;
+static float sensed;
+
+static uint64_t stepStart;
+static uint64_t onSince;
+static uint64_t onNs;
+
+static float delayed[PLANT_DELAY_MAX];
+static uint16_t delayPos;
+static uint16_t delaySteps;
+
+// Nearest sixteenth of degree
+static int16_t rawOf(float degrees)
+{
+    float raw = degrees * 16;
+    return (int16_t)(raw < 0 ? raw - 0.5f : raw + 0.5f);
+}
+
+void host_plant_attach(const HostPlant *params, float initial)
+{
+    plant = *params;
+    attached = true;
+    temperature = sensed = initial;
+    stepStart = host_ns;
+    onSince = host_getOutput(plant.pin) == plant.onLevel ? host_ns : 0;
+    onNs = 0;
+    delaySteps = min((uint16_t)(plant.deadTime * 10), PLANT_DELAY_MAX);
+    for (uint16_t i = 0; i < PLANT_DELAY_MAX; i++)
+        delayed[i] = initial;
+    delayPos = 0;
+    host_ds18b20_setRaw(rawOf(initial));
+}
+
+void host_plant_detach(void)
+{
+    attached = false;
+}
+
+float host_plant_temperature(void)
+{
+    return temperature;
+}
+
+void host_plant_setAmbient(float ambient)
+{
+    plant.ambient = ambient;
+}
+
+// Called by host.c on every change of pin level
+void host_plant_pinChanged(uint8_t pin, uint8_t level)
+{
+    if (!attached || pin != plant.pin)
+        return;
+    if (level == plant.onLevel)
+    {
+        if (!onSince)
+            onSince = host_ns;
+    }
+    else if (onSince)
+    {
+        onNs += host_ns - onSince;
+        onSince = 0;
+    }
+}
+
+// Called by host.c when simulated time advances
+void host_plant_advance(void)
+{
+    while (attached && host_ns >= stepStart + PLANT_STEP_NS)
+    {
+        uint64_t stepEnd = stepStart + PLANT_STEP_NS;
+        if (onSince)
+        {
+            onNs += stepEnd - max(onSince, stepStart);
+            onSince = stepEnd;
+        }
+        onNs = min(onNs, PLANT_STEP_NS);
+        host_stats.plantOnNs += onNs;
+        float power = (float)onNs / PLANT_STEP_NS;
+        onNs = 0;
+        stepStart = stepEnd;
+
+        float target = plant.ambient + plant.gain * power;
+        temperature += (target - temperature) * 0.1f / plant.timeConstant;
+
+        // sensor reads temperature of deadTime ago
+        float seen = delaySteps ? delayed[delayPos] : temperature;
+        delayed[delayPos] = temperature;
+        if (delaySteps && ++delayPos == delaySteps)
+            delayPos = 0;
+        if (plant.sensorLag > 0)
+            sensed += (seen - sensed) * 0.1f / plant.sensorLag;
+        else
+            sensed = seen;
+        host_ds18b20_setRaw(rawOf(sensed));
+    }
+}
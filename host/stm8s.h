@@ -0,0 +1,146 @@
+// Registers of STM8S peripherals used by firmware,
+// named like in STM8S Standard Peripheral Library.
+// Host simulates them in host.c.
+
+#ifndef stm8s_h
+#define stm8s_h
+
+#include <stdint.h>
+
+typedef struct GPIO_struct
+{
+    volatile uint8_t ODR;
+    volatile uint8_t IDR;
+    volatile uint8_t DDR;
+    volatile uint8_t CR1;
+    volatile uint8_t CR2;
+} GPIO_TypeDef;
+
+#define HOST_PORTS 4
+extern GPIO_TypeDef host_gpio[HOST_PORTS];
+#define GPIOA (&host_gpio[0])
+#define GPIOB (&host_gpio[1])
+#define GPIOC (&host_gpio[2])
+#define GPIOD (&host_gpio[3])
+
+typedef struct TIM1_struct
+{
+    volatile uint8_t CR1;
+    volatile uint8_t CR2;
+    volatile uint8_t SMCR;
+    volatile uint8_t ETR;
+    volatile uint8_t IER;
+    volatile uint8_t SR1;
+    volatile uint8_t SR2;
+    volatile uint8_t EGR;
+    volatile uint8_t CCMR1;
+    volatile uint8_t CCMR2;
+    volatile uint8_t CCMR3;
+    volatile uint8_t CCMR4;
+    volatile uint8_t CCER1;
+    volatile uint8_t CCER2;
+    volatile uint8_t CNTRH;
+    volatile uint8_t CNTRL;
+    volatile uint8_t PSCRH;
+    volatile uint8_t PSCRL;
+    volatile uint8_t ARRH;
+    volatile uint8_t ARRL;
+    volatile uint8_t RCR;
+} TIM1_TypeDef;
+
+extern TIM1_TypeDef host_tim1;
+#define TIM1 (&host_tim1)
+
+#define TIM1_CR1_ARPE ((uint8_t)0x80)
+#define TIM1_CR1_CEN ((uint8_t)0x01)
+#define TIM1_IER_UIE ((uint8_t)0x01)
+#define TIM1_SR1_UIF ((uint8_t)0x01)
+#define TIM1_EGR_UG ((uint8_t)0x01)
+
+typedef struct TIM2_struct
+{
+    volatile uint8_t CR1;
+    volatile uint8_t IER;
+    volatile uint8_t SR1;
+    volatile uint8_t SR2;
+    volatile uint8_t EGR;
+    volatile uint8_t CCMR1;
+    volatile uint8_t CCMR2;
+    volatile uint8_t CCMR3;
+    volatile uint8_t CCER1;
+    volatile uint8_t CCER2;
+    volatile uint8_t CNTRH;
+    volatile uint8_t CNTRL;
+    volatile uint8_t PSCR;
+    volatile uint8_t ARRH;
+    volatile uint8_t ARRL;
+} TIM2_TypeDef;
+
+extern TIM2_TypeDef host_tim2;
+#define TIM2 (&host_tim2)
+
+#define TIM2_CR1_ARPE ((uint8_t)0x80)
+#define TIM2_CR1_CEN ((uint8_t)0x01)
+#define TIM2_IER_UIE ((uint8_t)0x01)
+#define TIM2_SR1_UIF ((uint8_t)0x01)
+#define TIM2_EGR_UG ((uint8_t)0x01)
+
+typedef struct EXTI_struct
+{
+    volatile uint8_t CR1; // Sensitivity of ports A to D, two bits each
+    volatile uint8_t CR2;
+} EXTI_TypeDef;
+
+extern EXTI_TypeDef host_exti;
+#define EXTI (&host_exti)
+
+typedef struct UART1_struct
+{
+    volatile uint8_t SR;
+    // Wider than on STM8, so that host sees every write of it:
+    // host keeps HOST_UART_EMPTY in it while no byte is written,
+    // received byte is marked with HOST_UART_RECEIVED
+    volatile uint16_t DR;
+    volatile uint8_t BRR1;
+    volatile uint8_t BRR2;
+    volatile uint8_t CR1;
+    volatile uint8_t CR2;
+    volatile uint8_t CR3;
+    volatile uint8_t CR4;
+    volatile uint8_t CR5;
+    volatile uint8_t GTR;
+    volatile uint8_t PSCR;
+} UART1_TypeDef;
+
+#define HOST_UART_EMPTY 0x100
+#define HOST_UART_RECEIVED 0x200
+extern UART1_TypeDef host_uart1;
+#define UART1 (&host_uart1)
+
+#define UART1_SR_TXE ((uint8_t)0x80)
+#define UART1_SR_TC ((uint8_t)0x40)
+#define UART1_SR_RXNE ((uint8_t)0x20)
+#define UART1_CR2_TIEN ((uint8_t)0x80)
+#define UART1_CR2_TCIEN ((uint8_t)0x40)
+#define UART1_CR2_RIEN ((uint8_t)0x20)
+#define UART1_CR2_TEN ((uint8_t)0x08)
+#define UART1_CR2_REN ((uint8_t)0x04)
+#define UART1_CR5_HDSEL ((uint8_t)0x08)
+
+#define INTERRUPT_HANDLER(name, vector) void name(void)
+
+// Wait for interrupt: enables interrupts and sleeps
+// until the next timer interrupt is handled
+#define wfi() host_wfi()
+void host_wfi(void);
+
+void TIM1_UPD_OVF_TRG_BRK_IRQHandler(void);
+void TIM2_UPD_OVF_BRK_IRQHandler(void);
+void EXTI_PORTA_IRQHandler(void);
+void EXTI_PORTB_IRQHandler(void);
+void EXTI_PORTC_IRQHandler(void);
+void EXTI_PORTD_IRQHandler(void);
+void UART1_TX_IRQHandler(void);
+void UART1_RX_IRQHandler(void);
+
+#endif
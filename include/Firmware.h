@@ -0,0 +1,100 @@
+// Types, globals and functions of src/main.c which host
+// simulations and benchmarks (sim/, bench/) use, so they see
+// the firmware's own layout instead of copies of it.
+
+#ifndef Firmware_h
+#define Firmware_h
+
+#if defined(TempControl_AUTOTUNE) && !defined(TempControl_PID)
+#define TempControl_PID // tuning is done for PID mode
+#endif
+
+#include <Arduino.h>
+#include <SevSegC.h>
+#include <Scheduler.h>
+#include <SettingsLog.h>
+#include <SlowPWM.h>
+#ifdef TempControl_AUTOTUNE
+#include <RelayTune.h>
+#endif
+
+typedef struct Button
+{
+  uint8_t pin;
+  uint8_t timer;
+  uint8_t counter;
+
+  bool changed; // set by readButton, unset by handleButtonClick
+#ifdef Button_INTERRUPT
+  bool pressed; // debounced by Buttons
+  bool held;    // hold event came, unset by handleButtonClick
+  bool clicked; // press event came, unset by handleButtonClick
+#endif
+} Button;
+
+typedef struct TempControlSlot
+{
+  int16_t low;
+  int16_t high;
+} TempControlSlot;
+
+#define MenuState_DEFAULT 0
+#define MenuState_SHOW_TEMP 1
+#define MenuState_SET_LOW 11
+#define MenuState_SET_HIGH 12
+#define MenuState_SET_SLOT 20
+#define MenuState_AUTOTUNE 30 // stays while menu is closed, until test is over
+#define MenuState_PROFILE 40
+
+extern SevSeg display;
+extern uint8_t outputPin;
+extern uint8_t buttonUpPin;
+extern uint8_t buttonDownPin;
+extern uint8_t tempSensorPin;
+extern int16_t tempUpdatePrev;
+#ifdef TempSensor_LAG_FILTER
+extern uint16_t tempSensorLag;
+#endif
+extern SettingsLog settings;
+extern uint8_t tempControlCurrentSlot;
+extern TempControlSlot tempControlSlots[];
+#ifdef TempControl_PID
+extern uint8_t tempControlPidSlots;
+#endif
+#ifdef TempControl_AUTOTUNE
+extern RelayTune tune;
+#endif
+extern Button buttonUp;
+extern Button buttonDown;
+extern SlowPWM output;
+extern uint8_t menuState;
+extern uint8_t menuActiveCounter;
+extern Scheduler scheduler;
+#ifdef SCHEDULER_PROFILE
+extern ProfileCounter profileOneWire;
+#endif
+
+void setup();
+void loop();
+void task_refreshDisplay();
+void task_input();
+void task_temperature();
+void task_buttonHold();
+void task_menuDecay();
+void task_output();
+#ifdef Telemetry_UART
+void task_telemetry();
+#endif
+#ifdef Modbus_RTU
+void task_modbus();
+#endif
+#ifdef Button_INTERRUPT
+void readButtonEvents();
+#else
+void readButton(Button *button);
+#endif
+void displayMenu_dispatcher();
+void displayNumber(int16_t value, bool integer);
+void updateTemperature();
+
+#endif
@@ -0,0 +1,141 @@
+#include <Buttons.h>
+
+#define BUTTONS_EXTI_BOTH_EDGES 3 // Sensitivity bits of a port in EXTI_CR1
+
+typedef struct ButtonState
+{
+    GPIO_TypeDef *gpio;
+    uint8_t mask;
+    uint32_t lastEdge; // millis() of accepted edge
+    uint16_t holdNext; // millis() of the next hold event
+} ButtonState;
+
+static ButtonState buttons[BUTTONS_MAX];
+static uint8_t buttonsCount;
+
+static volatile uint8_t pressedMask;
+static volatile uint8_t bouncingMask; // changed again after accepted edge
+
+// Both interrupt and update push to it, but update does it
+// with interrupts disabled, so there is one producer at a time
+static EventRing events;
+
+// Take the level of the button, if it is new and debounce time passed
+static void buttons_sample(uint8_t button, uint32_t now)
+{
+    ButtonState *state = &buttons[button];
+    uint8_t bit = 1 << button;
+    bool pressed = !(state->gpio->IDR & state->mask);
+    if (pressed == ((pressedMask & bit) != 0))
+    {
+        bouncingMask &= ~bit;
+        return;
+    }
+    if (now - state->lastEdge < BUTTONS_DEBOUNCE_MS)
+    {
+        bouncingMask |= bit; // Checked again when time passes
+        return;
+    }
+
+    bouncingMask &= ~bit;
+    state->lastEdge = now;
+    if (pressed)
+    {
+        pressedMask |= bit;
+        state->holdNext = (uint16_t)now + BUTTONS_HOLD_MS;
+        eventring_push(&events, BUTTONS_PRESS, button, (int16_t)now);
+    }
+    else
+    {
+        pressedMask &= ~bit;
+        eventring_push(&events, BUTTONS_RELEASE, button, (int16_t)now);
+    }
+}
+
+static void buttons_edge(void)
+{
+    uint32_t now = millis();
+    for (uint8_t button = 0; button < buttonsCount; button++)
+        buttons_sample(button, now);
+}
+
+// Pins are set to INPUT_PULLUP with interrupt on both edges
+void buttons_begin(const uint8_t *pins, uint8_t count)
+{
+    buttonsCount = min(count, BUTTONS_MAX);
+    pressedMask = bouncingMask = 0;
+    eventring_begin(&events);
+
+    // sensitivity can be changed only with interrupts disabled
+    noInterrupts();
+    for (uint8_t button = 0; button < buttonsCount; button++)
+    {
+        uint8_t port = digitalPinToPort(pins[button]);
+        ButtonState *state = &buttons[button];
+        state->gpio = (GPIO_TypeDef *)portOutputRegister(port);
+        state->mask = digitalPinToBitMask(pins[button]);
+        state->lastEdge = millis() - BUTTONS_DEBOUNCE_MS;
+
+        pinMode(pins[button], INPUT_PULLUP);
+        EXTI->CR1 |= BUTTONS_EXTI_BOTH_EDGES << ((port - PA) * 2);
+        state->gpio->CR2 |= state->mask; // Interrupt enabled
+    }
+    interrupts();
+}
+
+// Finish debouncing and make hold events, call it often
+// (every millisecond or so), it returns at once when idle
+void buttons_update(void)
+{
+    if (!(pressedMask | bouncingMask))
+        return;
+
+    noInterrupts();
+    uint32_t now = millis();
+    for (uint8_t button = 0; button < buttonsCount; button++)
+    {
+        uint8_t bit = 1 << button;
+        if (bouncingMask & bit)
+            buttons_sample(button, now);
+
+        ButtonState *state = &buttons[button];
+        if ((pressedMask & bit) && (int16_t)((uint16_t)now - state->holdNext) >= 0)
+        {
+            eventring_push(&events, BUTTONS_HOLD, button, state->holdNext);
+            state->holdNext += BUTTONS_REPEAT_MS;
+        }
+    }
+    interrupts();
+}
+
+// Take the oldest event, return false if there is none
+bool buttons_next(Event *event)
+{
+    return eventring_pop(&events, event);
+}
+
+// Debounced level
+bool buttons_pressed(uint8_t button)
+{
+    return pressedMask & (1 << button);
+}
+
+INTERRUPT_HANDLER(EXTI_PORTA_IRQHandler, 3)
+{
+    buttons_edge();
+}
+
+INTERRUPT_HANDLER(EXTI_PORTB_IRQHandler, 4)
+{
+    buttons_edge();
+}
+
+INTERRUPT_HANDLER(EXTI_PORTC_IRQHandler, 5)
+{
+    buttons_edge();
+}
+
+INTERRUPT_HANDLER(EXTI_PORTD_IRQHandler, 6)
+{
+    buttons_edge();
+}
@@ -0,0 +1,43 @@
+// Buttons read by external interrupts (EXTI) instead of polling.
+//
+// Every edge of a button pin interrupts, the first edge after
+// BUTTONS_DEBOUNCE_MS of quiet is taken at once and timestamped,
+// bounces after it are ignored. Events (press, release and hold
+// repeats while pressed) go to EventRing read by buttons_next,
+// with millis() of the edge (low 16 bits) as value.
+// While no button is pressed or bouncing, buttons_update returns
+// at once, so input costs nothing at idle.
+//
+// Buttons are active low (pulled up) and may be on any ports,
+// but EXTI sensitivity is set for whole port, so other pins
+// of their ports must not use interrupts with other settings.
+
+#ifndef Buttons_h
+#define Buttons_h
+
+#include <Arduino.h>
+#include <EventRing.h>
+
+#ifndef BUTTONS_MAX
+#define BUTTONS_MAX 2
+#endif
+#ifndef BUTTONS_DEBOUNCE_MS
+#define BUTTONS_DEBOUNCE_MS 10
+#endif
+#ifndef BUTTONS_HOLD_MS
+#define BUTTONS_HOLD_MS 250 // first hold event after press
+#endif
+#ifndef BUTTONS_REPEAT_MS
+#define BUTTONS_REPEAT_MS 50 // next ones while still pressed
+#endif
+
+#define BUTTONS_PRESS 0
+#define BUTTONS_RELEASE 1
+#define BUTTONS_HOLD 2
+
+void buttons_begin(const uint8_t *pins, uint8_t count);
+void buttons_update(void);
+bool buttons_next(Event *event); // source is index in pins
+bool buttons_pressed(uint8_t button);
+
+#endif
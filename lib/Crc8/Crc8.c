@@ -0,0 +1,22 @@
+#include <Crc8.h>
+
+// CRC-8 table of all byte values is linear in the byte, so it is
+// split in two tables of 16 for low and high nibbles (32 bytes of flash
+// instead of 256, and no bit loop)
+static const uint8_t crcLowNibble[16] = {
+    0x00, 0x5E, 0xBC, 0xE2, 0x61, 0x3F, 0xDD, 0x83,
+    0xC2, 0x9C, 0x7E, 0x20, 0xA3, 0xFD, 0x1F, 0x41};
+static const uint8_t crcHighNibble[16] = {
+    0x00, 0x9D, 0x23, 0xBE, 0x46, 0xDB, 0x65, 0xF8,
+    0x8C, 0x11, 0xAF, 0x32, 0xCA, 0x57, 0xE9, 0x74};
+
+uint8_t crc8(const uint8_t *data, uint8_t size)
+{
+    uint8_t crc = 0;
+    while (size--)
+    {
+        uint8_t index = crc ^ *data++;
+        crc = crcLowNibble[index & 0x0F] ^ crcHighNibble[index >> 4];
+    }
+    return crc;
+}
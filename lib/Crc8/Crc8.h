@@ -0,0 +1,12 @@
+// Dallas/Maxim CRC-8 (x^8 + x^5 + x^4 + 1, reflected), the one
+// DS18B20 uses, shared by nanoOneWire, SettingsLog and Telemetry.
+// CRC of data followed by its CRC byte is zero.
+
+#ifndef Crc8_h
+#define Crc8_h
+
+#include <Arduino.h>
+
+uint8_t crc8(const uint8_t *data, uint8_t size);
+
+#endif
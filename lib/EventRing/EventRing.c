@@ -0,0 +1,52 @@
+#include <EventRing.h>
+
+#define EVENTRING_MASK (EVENTRING_SIZE - 1)
+
+// Call before producer and consumer start
+void eventring_begin(EventRing *ring)
+{
+    ring->head = ring->tail = 0;
+    ring->dropped = 0;
+}
+
+// Producer side: return false (and count it) if ring is full
+bool eventring_push(EventRing *ring, uint8_t type, uint8_t source, int16_t value)
+{
+    uint8_t head = ring->head;
+    if ((uint8_t)(head - ring->tail) >= EVENTRING_SIZE)
+    {
+        ring->dropped++;
+        return false;
+    }
+
+    volatile Event *event = &ring->events[head & EVENTRING_MASK];
+    event->type = type;
+    event->source = source;
+    event->value = value;
+    EVENTRING_FENCE(); // Event is complete before it is published
+    ring->head = head + 1;
+    return true;
+}
+
+// Consumer side: take the oldest event, return false if there is none
+bool eventring_pop(EventRing *ring, Event *event)
+{
+    uint8_t tail = ring->tail;
+    if (tail == ring->head)
+        return false;
+
+    EVENTRING_FENCE(); // Event is read after head that published it
+    volatile Event *slot = &ring->events[tail & EVENTRING_MASK];
+    event->type = slot->type;
+    event->source = slot->source;
+    event->value = slot->value;
+    EVENTRING_FENCE(); // Slot is read before it is given back
+    ring->tail = tail + 1;
+    return true;
+}
+
+// Either side: events waiting, may be stale by the time it returns
+uint8_t eventring_count(EventRing *ring)
+{
+    return ring->head - ring->tail;
+}
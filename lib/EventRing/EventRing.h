@@ -0,0 +1,46 @@
+// Queue of small typed events from one interrupt to the main loop.
+//
+// Single producer, single consumer: head is written only by the
+// producer, tail only by the consumer, so neither side masks
+// interrupts. Indices are 8 bit and run freely, their difference
+// is the count of events, so the size must be a power of two.
+// Event is 4 bytes, ring of 8 of them takes 35 bytes of RAM.
+
+#ifndef EventRing_h
+#define EventRing_h
+
+#include <Arduino.h>
+
+#ifndef EVENTRING_SIZE
+#define EVENTRING_SIZE 8 // 2 to 128, power of two
+#endif
+
+// STM8 has one core and SDCC keeps order of volatile accesses,
+// other compilers (host tests with threads) need a real fence
+#ifdef __SDCC
+#define EVENTRING_FENCE()
+#else
+#define EVENTRING_FENCE() __atomic_thread_fence(__ATOMIC_SEQ_CST)
+#endif
+
+typedef struct Event
+{
+    uint8_t type;   // Defined by producer
+    uint8_t source; // i.e. button index
+    int16_t value;  // i.e. temperature or timestamp
+} Event;
+
+typedef struct EventRing
+{
+    volatile Event events[EVENTRING_SIZE];
+    volatile uint8_t head; // Next to write, producer only
+    volatile uint8_t tail; // Next to read, consumer only
+    volatile uint8_t dropped; // Events lost because ring was full, producer only
+} EventRing;
+
+void eventring_begin(EventRing *ring);
+bool eventring_push(EventRing *ring, uint8_t type, uint8_t source, int16_t value);
+bool eventring_pop(EventRing *ring, Event *event);
+uint8_t eventring_count(EventRing *ring);
+
+#endif
@@ -0,0 +1,30 @@
+#include <LagFilter.h>
+
+void lagfilter_begin(LagFilter *filter, uint16_t lag)
+{
+    filter->lag = lag;
+    filter->started = false;
+}
+
+// Take the new sample, taken intervalMs after the previous one,
+// return estimate of what sensor would read without lag
+int16_t lagfilter_update(LagFilter *filter, int16_t sample, uint16_t intervalMs)
+{
+    int32_t measured = (int32_t)sample << 8;
+    if (!filter->started || intervalMs == 0 || intervalMs > LAGFILTER_GAP_MS)
+    {
+        filter->value = measured;
+        filter->rate = 0;
+        filter->started = true;
+        return sample;
+    }
+
+    // predict, then correct both value and rate by the residual
+    filter->value += filter->rate * intervalMs / 1000;
+    int32_t residual = measured - filter->value;
+    filter->value += (residual * LAGFILTER_ALPHA + 128) >> 8;
+    filter->rate += (residual * LAGFILTER_BETA * 1000 / intervalMs + 128) >> 8;
+
+    int32_t estimate = (filter->value + filter->rate * filter->lag) >> 8;
+    return constrain(estimate, INT16_MIN, INT16_MAX);
+}
@@ -0,0 +1,39 @@
+// Estimate of temperature sensor lags behind.
+//
+// Sensor in a sheath follows the medium as first order lag:
+// dS/dt = (T - S) / lag, so medium temperature is T = S + lag * dS/dt.
+// Alpha-beta filter tracks sensor temperature S and its rate
+// from the samples (which may come at uneven intervals),
+// and the rate projected over lag gives the estimate of T.
+// Values are in any integer units (temp*10 in main.c).
+
+#ifndef LagFilter_h
+#define LagFilter_h
+
+#include <Arduino.h>
+
+// Gains of the filter, with 8 fraction bits: higher alpha follows
+// samples closer, higher beta follows rate changes faster
+// (and lets more noise into the estimate)
+#ifndef LAGFILTER_ALPHA
+#define LAGFILTER_ALPHA 64 // 0.25
+#endif
+#ifndef LAGFILTER_BETA
+#define LAGFILTER_BETA 4 // 0.016
+#endif
+
+// Interval of samples after which filter starts over
+#define LAGFILTER_GAP_MS 10000
+
+typedef struct LagFilter
+{
+    uint16_t lag; // Time constant of the sensor, in seconds
+    int32_t value; // Sensor temperature, 8 fraction bits
+    int32_t rate;  // Per second, 8 fraction bits
+    bool started;
+} LagFilter;
+
+void lagfilter_begin(LagFilter *filter, uint16_t lag);
+int16_t lagfilter_update(LagFilter *filter, int16_t sample, uint16_t intervalMs);
+
+#endif
@@ -0,0 +1,188 @@
+#include <Modbus.h>
+#include <Uart.h>
+#include <TimerTick.h>
+
+static uint8_t slaveAddress;
+static ModbusReadHandler readHandler;
+static ModbusWriteHandler writeHandler;
+
+// Written by RX interrupt until the frame is ready,
+// then by modbus_poll until it is answered
+static uint8_t frame[MODBUS_FRAME_MAX];
+static volatile uint8_t frameSize;
+static volatile bool frameReady;
+static volatile uint8_t silentTicks;
+static uint8_t frameGapTicks; // 3.5 characters
+
+static void modbus_receive(uint8_t byte)
+{
+    if (frameReady)
+        return;
+    silentTicks = 0;
+    // too long frame is kept too long, so it fails CRC
+    if (frameSize < MODBUS_FRAME_MAX)
+        frame[frameSize] = byte;
+    if (frameSize != 0xFF)
+        frameSize++;
+}
+
+static void modbus_tick(void)
+{
+    if (!frameSize || frameReady)
+        return;
+    if (++silentTicks >= frameGapTicks)
+        frameReady = true;
+}
+
+// Polynomial 0xA001, initial 0xFFFF, sent low byte first
+static uint16_t modbus_crc(const uint8_t *data, uint8_t size)
+{
+    uint16_t crc = 0xFFFF;
+    while (size--)
+    {
+        crc ^= *data++;
+        for (uint8_t bit = 0; bit < 8; bit++)
+            crc = (crc & 1) ? (crc >> 1) ^ 0xA001 : crc >> 1;
+    }
+    return crc;
+}
+
+static uint16_t modbus_get16(const uint8_t *bytes)
+{
+    return ((uint16_t)bytes[0] << 8) | bytes[1];
+}
+
+static uint8_t *modbus_put16(uint8_t *bytes, uint16_t value)
+{
+    *bytes++ = (uint8_t)(value >> 8);
+    *bytes++ = (uint8_t)value;
+    return bytes;
+}
+
+// Start UART receiver and frame timing, address is 1 to 247
+void modbus_begin(uint8_t address, uint32_t baud, ModbusReadHandler read, ModbusWriteHandler write)
+{
+    slaveAddress = address;
+    readHandler = read;
+    writeHandler = write;
+    frameSize = 0;
+    frameReady = false;
+
+    if (!timertick_period())
+        timertick_begin(MODBUS_TICK_US);
+    // above 19200 baud the gap is fixed to 1750 us
+    uint32_t gapUs = baud > 19200 ? 1750 : 35000000UL / baud;
+    frameGapTicks = (uint8_t)(gapUs / timertick_period() + 1);
+    timertick_attach(modbus_tick, 1);
+
+    uart_begin(baud);
+    uart_receive(modbus_receive);
+}
+
+// Execute request, fill answer after address and function,
+// return its size or 0 with exception code in answer[0]
+static uint8_t modbus_execute(uint8_t function, const uint8_t *request, uint8_t requestSize, uint8_t *answer)
+{
+    uint16_t address = modbus_get16(request);
+    uint16_t count = modbus_get16(request + 2);
+    uint8_t exception = 0;
+    uint8_t *out = answer;
+
+    switch (function)
+    {
+    case MODBUS_READ_HOLDING:
+    case MODBUS_READ_INPUT:
+        if (requestSize != 4 || !count || count > MODBUS_MAX_REGISTERS)
+        {
+            exception = MODBUS_ILLEGAL_VALUE;
+            break;
+        }
+        *out++ = (uint8_t)(count * 2);
+        for (uint8_t i = 0; i < count && !exception; i++)
+        {
+            uint16_t value = 0;
+            exception = readHandler(function, address + i, &value);
+            out = modbus_put16(out, value);
+        }
+        break;
+
+    case MODBUS_WRITE_SINGLE:
+        if (requestSize != 4)
+        {
+            exception = MODBUS_ILLEGAL_VALUE;
+            break;
+        }
+        exception = writeHandler(address, count, false);
+        if (!exception)
+            exception = writeHandler(address, count, true);
+        out = modbus_put16(modbus_put16(out, address), count);
+        break;
+
+    case MODBUS_WRITE_MULTIPLE:
+        if (!count || count > MODBUS_MAX_REGISTERS ||
+            request[4] != count * 2 || requestSize != 5 + count * 2)
+        {
+            exception = MODBUS_ILLEGAL_VALUE;
+            break;
+        }
+        // all values are checked before any of them is written
+        for (uint8_t i = 0; i < count && !exception; i++)
+            exception = writeHandler(address + i, modbus_get16(request + 5 + i * 2), false);
+        for (uint8_t i = 0; i < count && !exception; i++)
+            exception = writeHandler(address + i, modbus_get16(request + 5 + i * 2), true);
+        out = modbus_put16(modbus_put16(out, address), count);
+        break;
+
+    default:
+        exception = MODBUS_ILLEGAL_FUNCTION;
+    }
+
+    if (exception)
+    {
+        answer[0] = exception;
+        return 0;
+    }
+    return out - answer;
+}
+
+// Answer the request, if a whole one has come.
+// Return true if it was for this slave (or broadcast) and valid,
+// then registers may have been written.
+bool modbus_poll(void)
+{
+    if (!frameReady)
+        return false;
+
+    bool executed = false;
+    uint8_t size = frameSize;
+    uint8_t address = frame[0];
+    if (size >= 4 && size <= MODBUS_FRAME_MAX &&
+        (address == slaveAddress || address == 0) &&
+        modbus_crc(frame, size - 2) == (frame[size - 2] | ((uint16_t)frame[size - 1] << 8)))
+    {
+        uint8_t answer[UART_TX_SIZE];
+        uint8_t function = frame[1];
+        uint8_t answerSize = modbus_execute(function, frame + 2, size - 4, answer + 2);
+        answer[0] = address;
+        answer[1] = function;
+        if (answerSize)
+        {
+            answerSize += 2;
+        }
+        else
+        {
+            answer[1] |= 0x80;
+            answerSize = 3;
+        }
+        uint16_t crc = modbus_crc(answer, answerSize);
+        answer[answerSize++] = (uint8_t)crc;
+        answer[answerSize++] = (uint8_t)(crc >> 8);
+        if (address)
+            uart_write(answer, answerSize);
+        executed = true;
+    }
+
+    frameSize = 0;
+    frameReady = false; // Receiving again
+    return executed;
+}
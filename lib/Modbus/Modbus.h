@@ -0,0 +1,53 @@
+// Modbus RTU slave over UART (see Uart.h).
+//
+// Request bytes are stored by the RX interrupt, frame ends after
+// 3.5 characters of silence, counted on TIM2 tick (see TimerTick.h).
+// Frame is parsed and answered by modbus_poll in the main loop,
+// so interrupts stay short. They still come during OneWire transactions
+// (every byte on the bus, also to other slaves), and blocking OneWire
+// keeps them off in the timed part of each slot (see nanoOneWire.c).
+// Bytes coming before the frame is answered are dropped, as
+// a master waits for the answer before the next request anyway.
+//
+// Functions: read holding registers (3), read input registers (4),
+// write single register (6), write multiple registers (16).
+// Registers are read and written one by one through handlers,
+// which return 0 or Modbus exception code. Write handler is called
+// with apply false for every register of a request first, and
+// must only check the value then, so a request with any invalid
+// value changes nothing. Requests to address 0 (broadcast)
+// are executed without answer.
+
+#ifndef Modbus_h
+#define Modbus_h
+
+#include <Arduino.h>
+
+// Registers in one request, answer must fit in UART_TX_SIZE
+#ifndef MODBUS_MAX_REGISTERS
+#define MODBUS_MAX_REGISTERS 13
+#endif
+#define MODBUS_FRAME_MAX (9 + 2 * MODBUS_MAX_REGISTERS)
+
+// Tick of TIM2 started by modbus_begin, if nothing has started it
+#ifndef MODBUS_TICK_US
+#define MODBUS_TICK_US 200
+#endif
+
+#define MODBUS_READ_HOLDING 3
+#define MODBUS_READ_INPUT 4
+#define MODBUS_WRITE_SINGLE 6
+#define MODBUS_WRITE_MULTIPLE 16
+
+#define MODBUS_ILLEGAL_FUNCTION 1
+#define MODBUS_ILLEGAL_ADDRESS 2
+#define MODBUS_ILLEGAL_VALUE 3
+
+// function is MODBUS_READ_HOLDING or MODBUS_READ_INPUT
+typedef uint8_t (*ModbusReadHandler)(uint8_t function, uint16_t address, uint16_t *value);
+typedef uint8_t (*ModbusWriteHandler)(uint16_t address, uint16_t value, bool apply);
+
+void modbus_begin(uint8_t address, uint32_t baud, ModbusReadHandler read, ModbusWriteHandler write);
+bool modbus_poll(void);
+
+#endif
@@ -0,0 +1,69 @@
+#include <PID.h>
+
+void pid_begin(PID *pid, int16_t outMin, int16_t outMax)
+{
+    pid->outMin = outMin;
+    pid->outMax = outMax;
+    pid->kp = pid->ki = pid->kd = 0;
+    pid_reset(pid);
+}
+
+void pid_setGains(PID *pid, int16_t kp, int16_t ki, int16_t kd)
+{
+    pid->kp = kp;
+    pid->ki = ki;
+    pid->kd = kd;
+}
+
+// Set gains from ultimate gain ku (PID_KP_SHIFT fraction bits)
+// and ultimate period tu (in updates), found by relay test.
+// Tyreus-Luyben PI rule (kp = ku / 3.2, ti = 2.2 tu) is used:
+// derivative of the rule (td = tu / 6.3) acts on every 1/16 C step
+// of the sensor, and in simulation it doubled overshoot and error
+// (see sim/autotune.c).
+void pid_setUltimate(PID *pid, int16_t ku, uint16_t tu)
+{
+    int32_t kp = (int32_t)ku * 10 / 32;
+    int32_t ki = (kp << (PID_KI_SHIFT - PID_KP_SHIFT)) * 10 / ((int32_t)max(tu, 1) * 22);
+    pid_setGains(pid, kp, constrain(ki, 1, INT16_MAX), 0);
+}
+
+// Forget integral and previous input, i.e. when setpoint
+// is far from where it was, or controller was not in use
+void pid_reset(PID *pid)
+{
+    pid->integral = 0;
+    pid->started = false;
+}
+
+// Return output for the new input.
+//
+// Derivative is taken from input, not error, so setpoint change
+// does not kick output. Integral is clamped to output range
+// and does not grow while output is saturated (anti-windup).
+int16_t pid_update(PID *pid, int16_t setpoint, int16_t input)
+{
+    if (!pid->started)
+    {
+        pid->prevInput = input;
+        pid->started = true;
+    }
+
+    int16_t error = setpoint - input;
+    int32_t proportional = ((int32_t)pid->kp * error) >> PID_KP_SHIFT;
+    int32_t derivative = ((int32_t)pid->kd * (pid->prevInput - input)) >> PID_KD_SHIFT;
+    pid->prevInput = input;
+
+    int32_t integral = pid->integral + (int32_t)pid->ki * error;
+    int32_t integralMax = (int32_t)pid->outMax << PID_KI_SHIFT;
+    int32_t integralMin = (int32_t)pid->outMin << PID_KI_SHIFT;
+    integral = constrain(integral, integralMin, integralMax);
+
+    int32_t output = proportional + derivative + (integral >> PID_KI_SHIFT);
+    if ((output > pid->outMax && error > 0) || (output < pid->outMin && error < 0))
+        integral = pid->integral; // Keep it, it would only wind up
+
+    pid->integral = integral;
+    output = proportional + derivative + (integral >> PID_KI_SHIFT);
+    return constrain(output, pid->outMin, pid->outMax);
+}
@@ -0,0 +1,37 @@
+// Integer PID controller.
+//
+// Input and setpoint are in any integer units (temp*10 in main.c),
+// output is clamped to [outMin, outMax]. Gains are fixed point:
+// kp has PID_KP_SHIFT fraction bits, ki PID_KI_SHIFT and kd PID_KD_SHIFT,
+// so all of them fit in 16 bits for typical slow thermal plants.
+// Gains are per update, call pid_update at steady rate.
+
+#ifndef PID_h
+#define PID_h
+
+#include <Arduino.h>
+
+#define PID_KP_SHIFT 8
+#define PID_KI_SHIFT 16
+#define PID_KD_SHIFT 4
+
+typedef struct PID
+{
+    int16_t kp; // Output per unit of error
+    int16_t ki; // Output per unit of error, every update
+    int16_t kd; // Output per unit of input change in one update
+    int16_t outMin;
+    int16_t outMax;
+
+    int32_t integral; // In output units << PID_KI_SHIFT
+    int16_t prevInput;
+    bool started;
+} PID;
+
+void pid_begin(PID *pid, int16_t outMin, int16_t outMax);
+void pid_setGains(PID *pid, int16_t kp, int16_t ki, int16_t kd);
+void pid_setUltimate(PID *pid, int16_t ku, uint16_t tu);
+void pid_reset(PID *pid);
+int16_t pid_update(PID *pid, int16_t setpoint, int16_t input);
+
+#endif
@@ -0,0 +1,56 @@
+#include <Profile.h>
+
+#define PROFILE_PRESCALER 15 // F_CPU / 16, 1 MHz
+
+// Start TIM1 counting microseconds, without interrupts
+void profile_begin(void)
+{
+    TIM1->CR1 = 0;
+    TIM1->IER = 0;
+    TIM1->PSCRH = 0;
+    TIM1->PSCRL = PROFILE_PRESCALER;
+    TIM1->ARRH = 0xFF;
+    TIM1->ARRL = 0xFF;
+    TIM1->EGR = TIM1_EGR_UG; // Load prescaler right now
+    TIM1->CR1 = TIM1_CR1_CEN;
+}
+
+// Microseconds, running freely; difference of two readings
+// is the time between them
+uint16_t profile_now(void)
+{
+    // high byte is read first, it latches the low one
+    uint8_t high = TIM1->CNTRH;
+    return ((uint16_t)high << 8) | TIM1->CNTRL;
+}
+
+void profile_reset(ProfileCounter *counter)
+{
+    counter->min = UINT16_MAX;
+    counter->max = 0;
+    counter->total = 0;
+    counter->count = 0;
+}
+
+void profile_add(ProfileCounter *counter, uint16_t elapsed)
+{
+    if (elapsed < counter->min)
+        counter->min = elapsed;
+    if (elapsed > counter->max)
+        counter->max = elapsed;
+    if (counter->count == UINT16_MAX)
+    {
+        counter->total >>= 1;
+        counter->count >>= 1;
+    }
+    counter->total += elapsed;
+    counter->count++;
+}
+
+// Zero if nothing was added
+uint16_t profile_average(const ProfileCounter *counter)
+{
+    if (!counter->count)
+        return 0;
+    return counter->total / counter->count;
+}
@@ -0,0 +1,33 @@
+// Execution time counters for finding hot spots on the device.
+//
+// Time is read from TIM1, which runs free with 1 us ticks
+// (prescaler 16 on 16 MHz clock) after profile_begin,
+// so a reading costs a few cycles and intervals up to 65 ms
+// are measured. TIM1 is then taken, so OneWire can't use it
+// in background (nanods_ASYNC).
+//
+// Every counter keeps min, max and average of what is added to it.
+// Average is total / count; when count is about to overflow both
+// are halved, so it follows the recent values.
+
+#ifndef Profile_h
+#define Profile_h
+
+#include <Arduino.h>
+
+typedef struct ProfileCounter
+{
+    uint16_t min; // In microseconds
+    uint16_t max;
+    uint32_t total;
+    uint16_t count;
+} ProfileCounter;
+
+void profile_begin(void);
+uint16_t profile_now(void);
+
+void profile_reset(ProfileCounter *counter);
+void profile_add(ProfileCounter *counter, uint16_t elapsed);
+uint16_t profile_average(const ProfileCounter *counter);
+
+#endif
@@ -0,0 +1,84 @@
+#include <RelayTune.h>
+
+// 4 / pi with 12 fraction bits, describing function of the relay
+#define RELAYTUNE_4_PI 5215
+
+// outputOn is output while input is below setpoint, it is 0 above it
+void relaytune_begin(RelayTune *tune, int16_t setpoint, int16_t hysteresis, uint16_t outputOn)
+{
+    tune->setpoint = setpoint;
+    tune->hysteresis = hysteresis;
+    tune->outputOn = outputOn;
+    tune->on = false;
+    tune->state = RELAYTUNE_RUNNING;
+    tune->cycle = 0;
+    tune->cycleSamples = 0;
+    tune->samples = 0;
+    tune->swingSum = 0;
+    tune->periodSum = 0;
+    tune->ultimateGain = 0;
+    tune->ultimatePeriod = 0;
+}
+
+static void relaytune_finish(RelayTune *tune)
+{
+    tune->on = false;
+
+    // Relay of amplitude d (half of outputOn) makes oscillation of
+    // amplitude a (half of swing), ultimate gain is 4d / (pi * a)
+    int32_t swing = tune->swingSum / RELAYTUNE_CYCLES;
+    if (swing <= 0)
+    {
+        tune->state = RELAYTUNE_FAILED;
+        return;
+    }
+    int32_t gain = ((int32_t)tune->outputOn * RELAYTUNE_4_PI / swing) >> (12 - 8);
+    tune->ultimateGain = min(gain, INT16_MAX);
+    tune->ultimatePeriod = tune->periodSum / RELAYTUNE_CYCLES;
+    tune->state = RELAYTUNE_DONE;
+}
+
+// Take the new input, return output to apply until the next one.
+// Check state for the end of tuning, output is 0 after it.
+uint16_t relaytune_update(RelayTune *tune, int16_t input)
+{
+    if (tune->state != RELAYTUNE_RUNNING)
+        return 0;
+
+    // Give up if plant does not oscillate (i.e. heater is too weak)
+    if (++tune->samples == 0xFFFF)
+    {
+        tune->state = RELAYTUNE_FAILED;
+        tune->on = false;
+        return 0;
+    }
+
+    tune->cycleSamples++;
+    tune->cycleMax = max(tune->cycleMax, input);
+    tune->cycleMin = min(tune->cycleMin, input);
+
+    if (tune->on && input > tune->setpoint + tune->hysteresis)
+    {
+        tune->on = false;
+    }
+    else if (!tune->on && input < tune->setpoint - tune->hysteresis)
+    {
+        // Full cycle is from one switch on to the next one
+        if (tune->cycle > 1)
+        {
+            tune->swingSum += tune->cycleMax - tune->cycleMin;
+            tune->periodSum += tune->cycleSamples;
+        }
+        if (tune->cycle == RELAYTUNE_CYCLES + 1)
+        {
+            relaytune_finish(tune);
+            return 0;
+        }
+        tune->cycle++;
+        tune->on = true;
+        tune->cycleSamples = 0;
+        tune->cycleMax = tune->cycleMin = input;
+    }
+
+    return tune->on ? tune->outputOn : 0;
+}
@@ -0,0 +1,47 @@
+// Relay feedback auto-tuning (Astrom-Hagglund).
+//
+// Output is switched fully on below setpoint and off above it,
+// so the plant oscillates around the setpoint. Amplitude and period
+// of the oscillation give ultimate gain and period of the plant,
+// which PID gains are computed from (see pid_setUltimate).
+// Call relaytune_update at the same rate PID will be updated.
+
+#ifndef RelayTune_h
+#define RelayTune_h
+
+#include <Arduino.h>
+
+#define RELAYTUNE_RUNNING 0
+#define RELAYTUNE_DONE 1
+#define RELAYTUNE_FAILED 2
+
+// Oscillation cycles measured, the first one is skipped
+// as it starts from wherever the plant was
+#ifndef RELAYTUNE_CYCLES
+#define RELAYTUNE_CYCLES 4
+#endif
+
+typedef struct RelayTune
+{
+    int16_t setpoint;
+    int16_t hysteresis; // Against switching on noise, in input units
+    uint16_t outputOn;
+    bool on;
+    uint8_t state;
+
+    uint8_t cycle;         // Count of switches on
+    uint16_t cycleSamples; // Since the last switch on
+    uint16_t samples;      // Since the start, to give up some time
+    int16_t cycleMax;
+    int16_t cycleMin;
+    int32_t swingSum;  // Peak to peak, of measured cycles
+    uint32_t periodSum;
+
+    int16_t ultimateGain;    // Output per input unit, PID_KP_SHIFT fraction bits
+    uint16_t ultimatePeriod; // In updates
+} RelayTune;
+
+void relaytune_begin(RelayTune *tune, int16_t setpoint, int16_t hysteresis, uint16_t outputOn);
+uint16_t relaytune_update(RelayTune *tune, int16_t input);
+
+#endif
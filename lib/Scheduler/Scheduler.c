@@ -0,0 +1,142 @@
+#include <Scheduler.h>
+#ifdef SCHEDULER_TIMER
+#include <TimerTick.h>
+
+static Scheduler *timerScheduler;
+#endif
+
+// tickDuration: length of tick in microseconds
+void scheduler_begin(Scheduler *scheduler, uint16_t tickDuration)
+{
+    scheduler->numTasks = 0;
+    scheduler->tickDuration = tickDuration;
+    scheduler->nextTick = micros() + tickDuration;
+    scheduler->tickStart = 0;
+    scheduler->overruns = 0;
+#ifdef SCHEDULER_TIMER
+    scheduler->pendingTicks = 0;
+#endif
+#ifdef SCHEDULER_PROFILE
+    profile_reset(&scheduler->busy);
+#endif
+}
+
+#ifdef SCHEDULER_TIMER
+static void scheduler_timerTick(void)
+{
+    if (timerScheduler->pendingTicks < 0xFF)
+        timerScheduler->pendingTicks++;
+}
+
+// Take ticks from TIM2 interrupt, starting it if it is not started yet.
+// If the tick is already started, the closest multiple of its period is used.
+void scheduler_beginTimer(Scheduler *scheduler)
+{
+    timerScheduler = scheduler;
+    scheduler->pendingTicks = 0;
+
+    if (!timertick_period())
+        timertick_begin(scheduler->tickDuration);
+    timertick_attach(scheduler_timerTick,
+                     (scheduler->tickDuration + timertick_period() / 2) / timertick_period());
+}
+
+// Sleep until tick interrupt, return count of ticks since the last call.
+// WFI enables interrupts as it starts waiting, so tick can't come
+// between the check and the sleep.
+static uint8_t scheduler_waitTicks(Scheduler *scheduler)
+{
+    noInterrupts();
+    while (!scheduler->pendingTicks)
+    {
+        wfi();
+        noInterrupts();
+    }
+    uint8_t elapsed = scheduler->pendingTicks;
+    scheduler->pendingTicks = 0;
+    interrupts();
+    return elapsed;
+}
+#else
+// Spin until the next tick, return count of ticks since the last call
+static uint8_t scheduler_waitTicks(Scheduler *scheduler)
+{
+    uint8_t elapsed = 0;
+    do
+    {
+        int32_t sleepTime = (int32_t)(scheduler->nextTick - micros());
+        if (sleepTime > 0)
+            delayMicroseconds(sleepTime);
+
+        uint32_t now = micros();
+        while ((int32_t)(now - scheduler->nextTick) >= 0 && elapsed < 0xFF)
+        {
+            scheduler->nextTick += scheduler->tickDuration;
+            elapsed++;
+        }
+    } while (!elapsed);
+    return elapsed;
+}
+#endif
+
+// Run callback every period ticks, first time after delay ticks
+// (at the next tick, if delay is zero).
+// Tasks of the same tick run in order they were added.
+void scheduler_add(Scheduler *scheduler, SchedulerCallback callback, uint16_t period, uint16_t delay)
+{
+    if (scheduler->numTasks >= SCHEDULER_MAX_TASKS)
+        return;
+
+    SchedulerTask *task = &scheduler->tasks[scheduler->numTasks++];
+    task->callback = callback;
+    task->period = period;
+    task->countdown = delay + 1;
+#ifdef SCHEDULER_PROFILE
+    profile_reset(&task->profile);
+#endif
+}
+
+// Wait for the next tick and run tasks which are due.
+//
+// If tasks took longer than a tick, missed ticks are counted
+// as overruns, and every task which was due in them runs once,
+// keeping its phase, so periods stay exact on average.
+void scheduler_run(Scheduler *scheduler)
+{
+    uint8_t elapsed = scheduler_waitTicks(scheduler);
+
+    if (elapsed > 1)
+    {
+        scheduler->overruns += elapsed - 1;
+        // Don't try to catch up after long block
+        if (elapsed == 0xFF)
+            scheduler->nextTick = micros() + scheduler->tickDuration;
+    }
+
+    scheduler->tickStart = micros();
+#ifdef SCHEDULER_PROFILE
+    uint16_t busyStart = profile_now();
+#endif
+    for (uint8_t taskNum = 0; taskNum < scheduler->numTasks; taskNum++)
+    {
+        SchedulerTask *task = &scheduler->tasks[taskNum];
+        if (task->countdown > elapsed)
+        {
+            task->countdown -= elapsed;
+            continue;
+        }
+
+        uint16_t late = elapsed - task->countdown;
+        task->countdown = (late < task->period) ? task->period - late : task->period;
+#ifdef SCHEDULER_PROFILE
+        uint16_t start = profile_now();
+        task->callback();
+        profile_add(&task->profile, profile_now() - start);
+#else
+        task->callback();
+#endif
+    }
+#ifdef SCHEDULER_PROFILE
+    profile_add(&scheduler->busy, profile_now() - busyStart);
+#endif
+}
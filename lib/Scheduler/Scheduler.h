@@ -0,0 +1,64 @@
+// Cooperative scheduler for the main loop.
+//
+// Time is divided in ticks of fixed duration, each task
+// runs once in its period (in ticks). Tasks are counted down
+// instead of checking iteration number with modulo,
+// which is costly 32 bit division on STM8.
+//
+// With SCHEDULER_TIMER defined, ticks come from TIM2 interrupt
+// (see TimerTick.h) after scheduler_beginTimer, and the core
+// sleeps in WFI between them instead of spinning in delayMicroseconds.
+//
+// With SCHEDULER_PROFILE defined, time of every task and busy part
+// of every tick are counted (see Profile.h, profile_begin must be
+// called before the first tick). Without it they are not built at all.
+
+#ifndef Scheduler_h
+#define Scheduler_h
+
+#include <Arduino.h>
+#ifdef SCHEDULER_PROFILE
+#include <Profile.h>
+#endif
+
+#ifndef SCHEDULER_MAX_TASKS
+#define SCHEDULER_MAX_TASKS 8
+#endif
+
+typedef void (*SchedulerCallback)(void);
+
+typedef struct SchedulerTask
+{
+    SchedulerCallback callback;
+    uint16_t period;    // In ticks
+    uint16_t countdown; // Ticks left until next run
+#ifdef SCHEDULER_PROFILE
+    ProfileCounter profile;
+#endif
+} SchedulerTask;
+
+typedef struct Scheduler
+{
+    SchedulerTask tasks[SCHEDULER_MAX_TASKS];
+    uint8_t numTasks;
+
+    uint16_t tickDuration; // In microseconds
+    uint32_t nextTick;     // micros() when next tick starts
+    uint32_t tickStart;    // micros() when tasks of the last tick started
+    uint16_t overruns;     // Count of ticks missed because tasks took too long
+#ifdef SCHEDULER_TIMER
+    volatile uint8_t pendingTicks; // Counted by interrupt, taken by scheduler_run
+#endif
+#ifdef SCHEDULER_PROFILE
+    ProfileCounter busy; // From the start of tasks of a tick to their end
+#endif
+} Scheduler;
+
+void scheduler_begin(Scheduler *scheduler, uint16_t tickDuration);
+void scheduler_add(Scheduler *scheduler, SchedulerCallback callback, uint16_t period, uint16_t delay);
+void scheduler_run(Scheduler *scheduler);
+#ifdef SCHEDULER_TIMER
+void scheduler_beginTimer(Scheduler *scheduler);
+#endif
+
+#endif
@@ -0,0 +1,142 @@
+#include <SettingsLog.h>
+#include <Crc8.h>
+#include <EEPROM.h>
+#include <string.h>
+
+#define RECORD_CRC_SIZE (sizeof(SettingsRecord) - 1)
+
+static uint8_t settingslog_crc(const SettingsRecord *record)
+{
+    return ~crc8((const uint8_t *)record, RECORD_CRC_SIZE);
+}
+
+static uint16_t settingslog_address(SettingsLog *log, uint8_t recordNum)
+{
+    return log->start + (uint16_t)recordNum * sizeof(SettingsRecord);
+}
+
+static bool settingslog_load(SettingsLog *log, uint8_t recordNum, SettingsRecord *record)
+{
+    EEPROM_get(settingslog_address(log, recordNum), *record);
+    return record->key < SETTINGSLOG_MAX_KEYS && record->crc == settingslog_crc(record);
+}
+
+static uint8_t settingslog_next(SettingsLog *log, uint8_t recordNum)
+{
+    return recordNum + 1 < log->capacity ? recordNum + 1 : 0;
+}
+
+// Record is stored with the next sequence number at recordNum,
+// bytes which are already the same are not programmed
+static void settingslog_store(SettingsLog *log, SettingsRecord *record, uint8_t recordNum)
+{
+    record->seq = ++log->seq;
+    record->crc = settingslog_crc(record);
+
+    uint16_t address = settingslog_address(log, recordNum);
+    const uint8_t *bytes = (const uint8_t *)record;
+    for (uint8_t byteNum = 0; byteNum < sizeof(SettingsRecord); byteNum++)
+        EEPROM_update(address + byteNum, bytes[byteNum]);
+
+    log->latest[record->key] = recordNum;
+}
+
+// Find the latest record of every key.
+// Log takes 'size' bytes of EEPROM from 'start', at least
+// one record more than keys (record is 8 bytes by default).
+void settingslog_begin(SettingsLog *log, uint16_t start, uint16_t size)
+{
+    uint16_t latestSeq[SETTINGSLOG_MAX_KEYS];
+    bool found = false;
+    uint8_t newest = 0;
+
+    log->start = start;
+    log->capacity = min(size / sizeof(SettingsRecord), 0xFF);
+    log->seq = 0;
+    memset(log->latest, SETTINGSLOG_NONE, sizeof(log->latest));
+
+    for (uint8_t recordNum = 0; recordNum < log->capacity; recordNum++)
+    {
+        SettingsRecord record;
+        if (!settingslog_load(log, recordNum, &record))
+            continue;
+
+        // Sequence numbers are compared so they may wrap around
+        if (!found || (int16_t)(record.seq - log->seq) > 0)
+        {
+            log->seq = record.seq;
+            newest = recordNum;
+            found = true;
+        }
+        uint8_t *latest = &log->latest[record.key];
+        if (*latest == SETTINGSLOG_NONE || (int16_t)(record.seq - latestSeq[record.key]) > 0)
+        {
+            *latest = recordNum;
+            latestSeq[record.key] = record.seq;
+        }
+    }
+
+    log->head = found ? settingslog_next(log, newest) : 0;
+}
+
+// Copy the latest data of key, return false if it was never written
+bool settingslog_read(SettingsLog *log, uint8_t key, void *data, uint8_t size)
+{
+    SettingsRecord record;
+    if (log->latest[key] == SETTINGSLOG_NONE)
+        return false;
+    EEPROM_get(settingslog_address(log, log->latest[key]), record);
+    memcpy(data, record.data, min(size, SETTINGSLOG_DATA_SIZE));
+    return true;
+}
+
+// Key whose latest record it is, or SETTINGSLOG_NONE
+static uint8_t settingslog_owner(SettingsLog *log, uint8_t recordNum)
+{
+    for (uint8_t key = 0; key < SETTINGSLOG_MAX_KEYS; key++)
+        if (log->latest[key] == recordNum)
+            return key;
+    return SETTINGSLOG_NONE;
+}
+
+// Append data of key (up to SETTINGSLOG_DATA_SIZE bytes),
+// nothing is written if it did not change
+void settingslog_write(SettingsLog *log, uint8_t key, const void *data, uint8_t size)
+{
+    SettingsRecord record;
+    size = min(size, SETTINGSLOG_DATA_SIZE);
+    if (log->latest[key] != SETTINGSLOG_NONE)
+    {
+        EEPROM_get(settingslog_address(log, log->latest[key]), record);
+        if (!memcmp(record.data, data, size))
+            return;
+    }
+    memset(&record, 0, sizeof(record));
+    record.key = key;
+    memcpy(record.data, data, size);
+
+    // Latest record of a key is never written over, as power loss
+    // in the middle would leave that key no valid record at all.
+    // Head skips the one of this key. The one of other key is copied
+    // to the next free record first, so keys written rarely move
+    // along the ring and keep their sequence numbers recent.
+    uint8_t owner = settingslog_owner(log, log->head);
+    if (owner == key)
+    {
+        log->head = settingslog_next(log, log->head);
+        owner = settingslog_owner(log, log->head);
+    }
+    if (owner != SETTINGSLOG_NONE)
+    {
+        // there is one, as log has more records than keys
+        uint8_t recordNum = settingslog_next(log, log->head);
+        while (settingslog_owner(log, recordNum) != SETTINGSLOG_NONE)
+            recordNum = settingslog_next(log, recordNum);
+        SettingsRecord other;
+        EEPROM_get(settingslog_address(log, log->head), other);
+        settingslog_store(log, &other, recordNum);
+    }
+
+    settingslog_store(log, &record, log->head);
+    log->head = settingslog_next(log, log->head);
+}
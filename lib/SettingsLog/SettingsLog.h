@@ -0,0 +1,45 @@
+// Wear leveling store for small settings in data EEPROM.
+//
+// Every write appends a record (key, sequence number, data, CRC)
+// to a ring of records, so writes are spread over the whole area
+// instead of hitting the same bytes. The latest valid record
+// of each key wins; a record torn by power loss fails CRC
+// and the previous one is used instead.
+
+#ifndef SettingsLog_h
+#define SettingsLog_h
+
+#include <Arduino.h>
+
+#ifndef SETTINGSLOG_MAX_KEYS
+#define SETTINGSLOG_MAX_KEYS 16
+#endif
+
+#ifndef SETTINGSLOG_DATA_SIZE
+#define SETTINGSLOG_DATA_SIZE 4
+#endif
+
+#define SETTINGSLOG_NONE 0xFF
+
+typedef struct SettingsRecord
+{
+    uint16_t seq;
+    uint8_t key;
+    uint8_t data[SETTINGSLOG_DATA_SIZE];
+    uint8_t crc; // Inverted, so erased record is never valid
+} SettingsRecord;
+
+typedef struct SettingsLog
+{
+    uint16_t start;    // EEPROM address of the first record
+    uint8_t capacity;  // In records
+    uint8_t head;      // Record written next, unless it is latest of a key
+    uint16_t seq;      // Sequence number of the newest record
+    uint8_t latest[SETTINGSLOG_MAX_KEYS]; // Record of each key, or SETTINGSLOG_NONE
+} SettingsLog;
+
+void settingslog_begin(SettingsLog *log, uint16_t start, uint16_t size);
+bool settingslog_read(SettingsLog *log, uint8_t key, void *data, uint8_t size);
+void settingslog_write(SettingsLog *log, uint8_t key, const void *data, uint8_t size);
+
+#endif
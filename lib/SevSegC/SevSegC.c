@@ -13,21 +13,33 @@
 
 #include <SevSegC.h>
 
+#ifdef SEVSEG_TIMER
+#include <TimerTick.h>
+
+// How long each segment is lit, in microseconds
+#define SEVSEG_TIMER_PERIOD (1000000UL / ((uint32_t)SEVSEG_FRAME_RATE * NUM_SEGMENTS))
+
+static SevSeg *timerSevseg;
+#endif
+
 #define BLANK_IDX 10 // Must match with 'digitCodeMap'
 #define DASH_IDX 11
 #define PERIOD_IDX 12
 
-static const int32_t powersOf10[] = {
+static const sevseg_number_t powersOf10[] = {
     1, // 10^0
     10,
     100,
     1000,
     10000,
+#if MAXNUMDIGITS > 4
     100000,
     1000000,
     10000000,
     100000000,
-    1000000000}; // 10^9
+    1000000000 // 10^9
+#endif
+};
 
 // digitCodeMap indicate which segments must be illuminated to display
 // each number.
@@ -48,13 +60,14 @@ static const uint8_t digitCodeMap[] = {
     0b10000000, // 12  '.'  PERIOD
 };
 
-void sevseg_findDigits(SevSeg *sevseg, int32_t numToShow, int8_t decPlaces, uint8_t digits[]);
+void sevseg_findDigits(SevSeg *sevseg, sevseg_number_t numToShow, int8_t decPlaces, uint8_t digits[]);
 void sevseg_setDigitCodes(SevSeg *sevseg, const uint8_t digits[], int8_t decPlaces);
-void sevseg_setNewNum(SevSeg *sevseg, int32_t numToShow, int8_t decPlaces);
-void sevseg_segmentOn(SevSeg *sevseg, uint8_t segmentNum);
-void sevseg_segmentOff(SevSeg *sevseg, uint8_t segmentNum);
-void sevseg_digitOn(SevSeg *sevseg, uint8_t digitNum);
-void sevseg_digitOff(SevSeg *sevseg, uint8_t digitNum);
+void sevseg_setNewNum(SevSeg *sevseg, sevseg_number_t numToShow, int8_t decPlaces);
+uint8_t sevseg_findPort(SevSeg *sevseg, uint8_t pin);
+void sevseg_setPinBit(SevSeg *sevseg, uint8_t values[], uint8_t pin, uint8_t val);
+void sevseg_updateFrames(SevSeg *sevseg);
+void sevseg_toggleDigit(SevSeg *sevseg, uint8_t digitNum, uint8_t segmentBits);
+void sevseg_writePorts(SevSeg *sevseg, const uint8_t values[]);
 
 // begin
 /******************************************************************************/
@@ -86,109 +99,219 @@ void sevseg_begin(
     sevseg->digitPins[digitNum] = digitPinsIn[digitNum];
   }
 
-  // Set the pins as outputs, and turn them off
+  // Find out ports of the pins and what turns them off
+  sevseg->numPorts = 0;
   for (uint8_t digitNum = 0; digitNum < sevseg->numDigits; digitNum++)
   {
-    pinMode(sevseg->digitPins[digitNum], OUTPUT);
-    digitalWrite(sevseg->digitPins[digitNum], DIGIT_OFF_VAL);
+    sevseg_setPinBit(sevseg, sevseg->portOff, sevseg->digitPins[digitNum], DIGIT_OFF_VAL);
   }
 
   for (uint8_t segmentNum = 0; segmentNum < NUM_SEGMENTS; segmentNum++)
   {
-    pinMode(sevseg->segmentPins[segmentNum], OUTPUT);
-    digitalWrite(sevseg->segmentPins[segmentNum], SEGMENT_OFF_VAL);
+    sevseg_setPinBit(sevseg, sevseg->portOff, sevseg->segmentPins[segmentNum], SEGMENT_OFF_VAL);
   }
 
+  // Turn the pins off, and set them as outputs
+  for (uint8_t digitNum = 0; digitNum < sevseg->numDigits; digitNum++)
+  {
+    sevseg->digitCodes[digitNum] = digitCodeMap[BLANK_IDX];
+  }
+  sevseg_updateFrames(sevseg);
+  sevseg->numCached = false;
   sevseg_blank(sevseg); // Initialise the display
+
+  for (uint8_t digitNum = 0; digitNum < sevseg->numDigits; digitNum++)
+  {
+    pinMode(sevseg->digitPins[digitNum], OUTPUT);
+  }
+
+  for (uint8_t segmentNum = 0; segmentNum < NUM_SEGMENTS; segmentNum++)
+  {
+    pinMode(sevseg->segmentPins[segmentNum], OUTPUT);
+  }
 }
 
-// refreshDisplay
+// findPort
 /******************************************************************************/
-// Turns on the segments specified in 'digitCodes[]'
-// For resistors on *digits* we will cycle through all 8 segments (7 + period),
-//    turning on the *digits* as appropriate for a given segment, before moving on
-//    to the next segment.
-void sevseg_refreshDisplay(SevSeg *sevseg)
+// Returns index of the pin's port in 'portOutputs', adding the port if it's new.
+// Returns SEVSEG_MAXPORTS if there is no room for it.
+uint8_t sevseg_findPort(SevSeg *sevseg, uint8_t pin)
 {
-  /**********************************************/
-  // RESISTORS ON DIGITS, UPDATE WITHOUT DELAYS
-
-  // Turn all lights off for the previous segment
-  sevseg_segmentOff(sevseg, sevseg->prevUpdateIdx);
+  volatile uint8_t *out = portOutputRegister(digitalPinToPort(pin));
+  uint8_t portNum = 0;
+  for (; portNum < sevseg->numPorts; portNum++)
+  {
+    if (sevseg->portOutputs[portNum] == out)
+      return portNum;
+  }
 
-  sevseg->prevUpdateIdx++;
-  if (sevseg->prevUpdateIdx >= NUM_SEGMENTS) {
-    sevseg->prevUpdateIdx = 0;
+  if (portNum < SEVSEG_MAXPORTS)
+  {
+    sevseg->portOutputs[portNum] = out;
+    sevseg->portMasks[portNum] = 0;
+    sevseg->portOff[portNum] = 0;
+    sevseg->numPorts++;
   }
+  return portNum;
+}
 
-  // Illuminate the required digits for the new segment
-  sevseg_segmentOn(sevseg, sevseg->prevUpdateIdx);
+// setPinBit
+/******************************************************************************/
+// Sets bit of the pin in per port 'values' to the level 'val'
+void sevseg_setPinBit(SevSeg *sevseg, uint8_t values[], uint8_t pin, uint8_t val)
+{
+  uint8_t portNum = sevseg_findPort(sevseg, pin);
+  if (portNum >= SEVSEG_MAXPORTS)
+    return;
+
+  uint8_t mask = digitalPinToBitMask(pin);
+  sevseg->portMasks[portNum] |= mask;
+  if (val == HIGH)
+    values[portNum] |= mask;
+  else
+    values[portNum] &= ~mask;
 }
 
-// segmentOn
+// updateFrames
 /******************************************************************************/
-// Turns a segment on, as well as all corresponding digit pins
-// (according to digitCodes[])
-void sevseg_segmentOn(SevSeg *sevseg, uint8_t segmentNum)
+// Precomputes port values for every segment from 'digitCodes[]'.
+// Turns a segment on, as well as all corresponding digit pins.
+void sevseg_updateFrames(SevSeg *sevseg)
 {
-  digitalWrite(sevseg->segmentPins[segmentNum], SEGMENT_ON_VAL);
-  for (uint8_t digitNum = 0; digitNum < sevseg->numDigits; digitNum++)
+  for (uint8_t segmentNum = 0; segmentNum < NUM_SEGMENTS; segmentNum++)
   {
-    if (sevseg->digitCodes[digitNum] & (1 << segmentNum))
-    { // Check a single bit
-      digitalWrite(sevseg->digitPins[digitNum], DIGIT_ON_VAL);
+    uint8_t *frame = sevseg->portFrames[segmentNum];
+    for (uint8_t portNum = 0; portNum < sevseg->numPorts; portNum++)
+    {
+      frame[portNum] = sevseg->portOff[portNum];
+    }
+
+    sevseg_setPinBit(sevseg, frame, sevseg->segmentPins[segmentNum], SEGMENT_ON_VAL);
+    for (uint8_t digitNum = 0; digitNum < sevseg->numDigits; digitNum++)
+    {
+      if (sevseg->digitCodes[digitNum] & (1 << segmentNum))
+      { // Check a single bit
+        sevseg_setPinBit(sevseg, frame, sevseg->digitPins[digitNum], DIGIT_ON_VAL);
+      }
     }
   }
 }
 
-// segmentOff
+// toggleDigit
 /******************************************************************************/
-// Turns a segment off, as well as all digit pins
-void sevseg_segmentOff(SevSeg *sevseg, uint8_t segmentNum)
+// Flips the digit pin in frames of the segments whose bits are set,
+// cheap update of frames when code of one digit changes
+void sevseg_toggleDigit(SevSeg *sevseg, uint8_t digitNum, uint8_t segmentBits)
 {
-  for (uint8_t digitNum = 0; digitNum < sevseg->numDigits; digitNum++)
+  uint8_t pin = sevseg->digitPins[digitNum];
+  uint8_t portNum = sevseg_findPort(sevseg, pin);
+  if (portNum >= SEVSEG_MAXPORTS)
+    return;
+
+  uint8_t mask = digitalPinToBitMask(pin);
+  for (uint8_t segmentNum = 0; segmentNum < NUM_SEGMENTS; segmentNum++)
   {
-    digitalWrite(sevseg->digitPins[digitNum], DIGIT_OFF_VAL);
+    if (segmentBits & (1 << segmentNum))
+    {
+      sevseg->portFrames[segmentNum][portNum] ^= mask;
+    }
   }
-  digitalWrite(sevseg->segmentPins[segmentNum], SEGMENT_OFF_VAL);
 }
 
-// digitOn
+// writePorts
 /******************************************************************************/
-// Turns a digit on, as well as all corresponding segment pins
-// (according to digitCodes[])
-void sevseg_digitOn(SevSeg *sevseg, uint8_t digitNum)
+// Writes display bits of each port, other pins of the port are left intact
+void sevseg_writePorts(SevSeg *sevseg, const uint8_t values[])
 {
-  digitalWrite(sevseg->digitPins[digitNum], DIGIT_ON_VAL);
-  for (uint8_t segmentNum = 0; segmentNum < NUM_SEGMENTS; segmentNum++)
+  for (uint8_t portNum = 0; portNum < sevseg->numPorts; portNum++)
   {
-    if (sevseg->digitCodes[digitNum] & (1 << segmentNum))
-    { // Check a single bit
-      digitalWrite(sevseg->segmentPins[segmentNum], SEGMENT_ON_VAL);
-    }
+    volatile uint8_t *out = sevseg->portOutputs[portNum];
+    *out = (*out & ~sevseg->portMasks[portNum]) | values[portNum];
   }
 }
 
-// digitOff
+// refreshDisplay
 /******************************************************************************/
-// Turns a digit off, as well as all segment pins
-void sevseg_digitOff(SevSeg *sevseg, uint8_t digitNum)
+// Turns on the segments specified in 'digitCodes[]'
+// For resistors on *digits* we will cycle through all 8 segments (7 + period),
+//    turning on the *digits* as appropriate for a given segment, before moving on
+//    to the next segment.
+void sevseg_refreshDisplay(SevSeg *sevseg)
 {
-  for (uint8_t segmentNum = 0; segmentNum < NUM_SEGMENTS; segmentNum++)
+  // Pins were turned off by 'blank'
+  if (sevseg->blanked)
   {
-    digitalWrite(sevseg->segmentPins[segmentNum], SEGMENT_OFF_VAL);
+    return;
   }
-  digitalWrite(sevseg->digitPins[digitNum], DIGIT_OFF_VAL);
+
+  /**********************************************/
+  // RESISTORS ON DIGITS, UPDATE WITHOUT DELAYS
+
+  // Turn all lights off for the previous segment.
+  // With single port it's done by the write below at once,
+  // otherwise new segment would be lit with old digits for a moment.
+  if (sevseg->numPorts > 1)
+  {
+    sevseg_writePorts(sevseg, sevseg->portOff);
+  }
+
+  sevseg->prevUpdateIdx++;
+  if (sevseg->prevUpdateIdx >= NUM_SEGMENTS) {
+    sevseg->prevUpdateIdx = 0;
+  }
+
+  // Illuminate the required digits for the new segment
+  sevseg_writePorts(sevseg, sevseg->portFrames[sevseg->prevUpdateIdx]);
 }
 
+#ifdef SEVSEG_TIMER
+// beginTimer
+/******************************************************************************/
+// Hands refreshing over to TIM2 interrupt (see TimerTick.h), so every segment
+// stays on for the same time, whatever main loop is doing (i.e. blocked by OneWire).
+// If the tick is already started, the closest multiple of its period is used.
+// Don't call 'refreshDisplay' after this.
+// Interrupt writes display pins, so they must not share
+// ports with pins written from the main loop.
+static void sevseg_timerRefresh(void)
+{
+  sevseg_refreshDisplay(timerSevseg);
+}
+
+void sevseg_beginTimer(SevSeg *sevseg)
+{
+  timerSevseg = sevseg;
+
+  if (!timertick_period()) {
+    timertick_begin(SEVSEG_TIMER_PERIOD);
+  }
+  timertick_attach(sevseg_timerRefresh,
+                   (SEVSEG_TIMER_PERIOD + timertick_period() / 2) / timertick_period());
+}
+#endif
+
 // setNumber
 /******************************************************************************/
 // Receives an integer and passes it to 'setNewNum'.
 void sevseg_setNumber(SevSeg *sevseg, int32_t numToShow, int8_t decPlaces)
 { // int32_t
+  // Anything beyond MAXNUMDIGITS is shown as dashes anyway,
+  // so it is safe to narrow the number after clamping
+  const int32_t limit = powersOf10[MAXNUMDIGITS];
+  sevseg_setNewNum(sevseg, (sevseg_number_t)constrain(numToShow, -limit, limit), decPlaces);
+}
+
+// setNumber16
+/******************************************************************************/
+// Receives a 16 bit integer and passes it to 'setNewNum'.
+// Cheapest way to show fixed point number, no 32 bit math involved
+// when MAXNUMDIGITS is 4 or less.
+void sevseg_setNumber16(SevSeg *sevseg, int16_t numToShow, int8_t decPlaces)
+{ // int16_t
   sevseg_setNewNum(sevseg, numToShow, decPlaces);
 }
 
+#ifndef SEVSEG_NOFLOAT
 // setNumberF
 /******************************************************************************/
 // Receives a float, prepares it, and passes it to 'setNewNum'.
@@ -198,29 +321,37 @@ void sevseg_setNumberF(SevSeg *sevseg, float numToShow, int8_t decPlaces)
   numToShow = numToShow * powersOf10[decPlacesPos];
   // Modify the number so that it is rounded to an integer correctly
   numToShow += (numToShow >= 0.f) ? 0.5f : -0.5f;
-  sevseg_setNewNum(sevseg, (int32_t)numToShow, (int8_t)decPlaces);
+  sevseg_setNumber(sevseg, (int32_t)numToShow, (int8_t)decPlaces);
 }
+#endif
 
 // setNewNum
 /******************************************************************************/
 // Changes the number that will be displayed.
-void sevseg_setNewNum(SevSeg *sevseg, int32_t numToShow, int8_t decPlaces)
+// Number shown last (even if blanked since) needs no work at all,
+// so a flashing number costs nothing but the flag.
+void sevseg_setNewNum(SevSeg *sevseg, sevseg_number_t numToShow, int8_t decPlaces)
 {
-  uint8_t digits[MAXNUMDIGITS];
-  sevseg_findDigits(sevseg, numToShow, decPlaces, digits);
-  sevseg_setDigitCodes(sevseg, digits, decPlaces);
+  if (!sevseg->numCached || numToShow != sevseg->cachedNum || decPlaces != sevseg->cachedDecPlaces)
+  {
+    uint8_t digits[MAXNUMDIGITS];
+    sevseg_findDigits(sevseg, numToShow, decPlaces, digits);
+    sevseg_setDigitCodes(sevseg, digits, decPlaces);
+    sevseg->cachedNum = numToShow;
+    sevseg->cachedDecPlaces = decPlaces;
+    sevseg->numCached = true;
+  }
+  sevseg->blanked = false;
 }
 
 // blank
 /******************************************************************************/
+// Turns everything off, 'digitCodes' are kept to show them again
 void sevseg_blank(SevSeg *sevseg)
 {
-  for (uint8_t digitNum = 0; digitNum < sevseg->numDigits; digitNum++)
-  {
-    sevseg->digitCodes[digitNum] = digitCodeMap[BLANK_IDX];
-  }
-  sevseg_segmentOff(sevseg, 0);
-  sevseg_digitOff(sevseg, 0);
+  // Flag goes first, so interrupt refresh does not light a segment after the write
+  sevseg->blanked = true;
+  sevseg_writePorts(sevseg, sevseg->portOff);
 }
 
 // findDigits
@@ -228,10 +359,10 @@ void sevseg_blank(SevSeg *sevseg)
 // Decides what each digit will display.
 // Enforces the upper and lower limits on the number to be displayed.
 // digits[] is an output
-void sevseg_findDigits(SevSeg *sevseg, int32_t numToShow, int8_t decPlaces, uint8_t digits[])
+void sevseg_findDigits(SevSeg *sevseg, sevseg_number_t numToShow, int8_t decPlaces, uint8_t digits[])
 {
-  const int32_t maxNum = powersOf10[sevseg->numDigits] - 1;
-  const int32_t minNum = -(powersOf10[sevseg->numDigits - 1] - 1);
+  const sevseg_number_t maxNum = powersOf10[sevseg->numDigits] - 1;
+  const sevseg_number_t minNum = -(powersOf10[sevseg->numDigits - 1] - 1);
 
   // If the number is out of range, just display dashes
   if (numToShow > maxNum || numToShow < minNum)
@@ -254,12 +385,19 @@ void sevseg_findDigits(SevSeg *sevseg, int32_t numToShow, int8_t decPlaces, uint
     }
 
     // Find all digits for base's representation, starting with the most
-    // significant digit
+    // significant digit. Each is counted by subtracting its power of 10,
+    // at most 9 times, as STM8 has no division for 32 bits and no
+    // multiplication wider than 8 bits.
     for (; digitNum < sevseg->numDigits; digitNum++)
     {
-      int32_t factor = powersOf10[sevseg->numDigits - 1 - digitNum];
-      digits[digitNum] = numToShow / factor;
-      numToShow -= digits[digitNum] * factor;
+      const sevseg_number_t factor = powersOf10[sevseg->numDigits - 1 - digitNum];
+      uint8_t digit = 0;
+      while (numToShow >= factor)
+      {
+        numToShow -= factor;
+        digit++;
+      }
+      digits[digitNum] = digit;
     }
 
     // Find unnnecessary leading zeros and set them to BLANK
@@ -284,22 +422,29 @@ void sevseg_findDigits(SevSeg *sevseg, int32_t numToShow, int8_t decPlaces, uint
 
 // setDigitCodes
 /******************************************************************************/
-// Sets the 'digitCodes' that are required to display the input numbers
+// Sets the 'digitCodes' that are required to display the input numbers,
+// port values are updated only for digits that changed
 void sevseg_setDigitCodes(SevSeg *sevseg, const uint8_t digits[], int8_t decPlaces)
 {
-
   // Set the digitCode for each digit in the display
   for (uint8_t digitNum = 0; digitNum < sevseg->numDigits; digitNum++)
   {
-    sevseg->digitCodes[digitNum] = digitCodeMap[digits[digitNum]];
+    uint8_t digitCode = digitCodeMap[digits[digitNum]];
     // Set the decimal point segment
     if (decPlaces >= 0)
     {
       if (digitNum == sevseg->numDigits - 1 - decPlaces)
       {
-        sevseg->digitCodes[digitNum] |= digitCodeMap[PERIOD_IDX];
+        digitCode |= digitCodeMap[PERIOD_IDX];
       }
     }
+
+    uint8_t changedBits = sevseg->digitCodes[digitNum] ^ digitCode;
+    if (changedBits)
+    {
+      sevseg->digitCodes[digitNum] = digitCode;
+      sevseg_toggleDigit(sevseg, digitNum, changedBits);
+    }
   }
 }
 
@@ -1,5 +1,7 @@
 // This is C port with reduced functionality.
 // There is support for displaying integers and floats only.
+// Fixed point numbers are displayed as integers with decPlaces set,
+// i.e. 225 with decPlaces 1 is shown as 22.5
 
 /* SevSeg Library
  *
@@ -38,11 +40,31 @@
 #define SEGMENT_OFF_VAL LOW
 #endif
 
+#ifndef SEVSEG_MAXPORTS
+// How many GPIO ports display pins may be spread over
+#define SEVSEG_MAXPORTS 4
+#endif
+
+// Define SEVSEG_TIMER to refresh display from TIM2 tick interrupt
+// (see sevseg_beginTimer), SEVSEG_FRAME_RATE is count of full
+// display refreshes per second in this mode.
+#ifndef SEVSEG_FRAME_RATE
+#define SEVSEG_FRAME_RATE 125
+#endif
+
 #ifndef SevSeg_h
 #define SevSeg_h
 
 #include "Arduino.h"
 
+// Numbers up to 4 digits fit in 16 bits, which
+// STM8 divides in hardware (32 bit division is library call)
+#if MAXNUMDIGITS > 4
+typedef int32_t sevseg_number_t;
+#else
+typedef int16_t sevseg_number_t;
+#endif
+
 typedef struct SevSeg
 {
   uint8_t digitPins[MAXNUMDIGITS];
@@ -51,6 +73,20 @@ typedef struct SevSeg
 
   uint8_t prevUpdateIdx;            // The previously updated segment or digit
   uint8_t digitCodes[MAXNUMDIGITS]; // The active setting of each segment of each digit
+  bool blanked;                     // All off, 'digitCodes' are kept
+
+  // Number 'digitCodes' were found for, set again it is not converted
+  bool numCached;
+  sevseg_number_t cachedNum;
+  int8_t cachedDecPlaces;
+
+  // Output registers of ports display pins belong to,
+  // with values of display bits precomputed from 'digitCodes'
+  uint8_t numPorts;
+  volatile uint8_t *portOutputs[SEVSEG_MAXPORTS];
+  uint8_t portMasks[SEVSEG_MAXPORTS];                // Display bits of the port
+  uint8_t portOff[SEVSEG_MAXPORTS];                  // Everything is off
+  uint8_t portFrames[NUM_SEGMENTS][SEVSEG_MAXPORTS]; // Segment is lit
 } SevSeg;
 
 void sevseg_begin(SevSeg *sevseg,
@@ -59,9 +95,16 @@ void sevseg_begin(SevSeg *sevseg,
                   const uint8_t segmentPinsIn[]);
 
 void sevseg_refreshDisplay(SevSeg *sevseg);
+#ifdef SEVSEG_TIMER
+void sevseg_beginTimer(SevSeg *sevseg);
+#endif
 
 void sevseg_setNumber(SevSeg *sevseg, int32_t numToShow, int8_t decPlaces);
+void sevseg_setNumber16(SevSeg *sevseg, int16_t numToShow, int8_t decPlaces);
+// Define SEVSEG_NOFLOAT to leave float out of build
+#ifndef SEVSEG_NOFLOAT
 void sevseg_setNumberF(SevSeg *sevseg, float numToShow, int8_t decPlaces);
+#endif
 
 void sevseg_blank(SevSeg *sevseg);
 
@@ -0,0 +1,44 @@
+#include <SlowPWM.h>
+
+static void slowpwm_write(SlowPWM *pwm, bool on)
+{
+    pwm->on = on;
+    if (on == (pwm->onLevel == HIGH))
+        *pwm->output |= pwm->mask;
+    else
+        *pwm->output &= ~pwm->mask;
+}
+
+// Pin is turned off here, it may be configured as output after that.
+// Pin is written through its port register, so other pins
+// of the port must not be written from main loop
+// when slowpwm_step is called from interrupt.
+void slowpwm_begin(SlowPWM *pwm, uint8_t pin, uint8_t onLevel, uint16_t period)
+{
+    pwm->output = portOutputRegister(digitalPinToPort(pin));
+    pwm->mask = digitalPinToBitMask(pin);
+    pwm->onLevel = onLevel;
+    pwm->period = period;
+    pwm->step = 0;
+    pwm->high = 0;
+    slowpwm_write(pwm, false);
+}
+
+// New duty cycle is high / period, it takes effect on the current
+// cycle: output is turned off right away if it was on for longer
+void slowpwm_setHigh(SlowPWM *pwm, uint16_t high)
+{
+    pwm->high = high;
+}
+
+void slowpwm_step(SlowPWM *pwm)
+{
+    pwm->step++;
+    if (pwm->step >= pwm->period)
+        pwm->step = 0;
+
+    // Pin is written only when level changes
+    bool on = (pwm->step < pwm->high);
+    if (on != pwm->on)
+        slowpwm_write(pwm, on);
+}
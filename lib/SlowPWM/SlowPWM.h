@@ -0,0 +1,29 @@
+// Software PWM with a period of seconds, for loads
+// switched by relay or SSR (i.e. heater).
+//
+// Every call of slowpwm_step advances it by one step, so
+// the period is 'period' times the interval between calls.
+// Calling it from a timer interrupt (see TimerTick.h) keeps
+// duty cycle exact, whatever main loop is doing.
+
+#ifndef SlowPWM_h
+#define SlowPWM_h
+
+#include <Arduino.h>
+
+typedef struct SlowPWM
+{
+    volatile uint8_t *output; // Output register of the pin port
+    uint8_t mask;
+    uint8_t onLevel;
+    bool on;
+    uint16_t period; // Steps in one cycle
+    uint16_t step;
+    volatile uint16_t high; // Steps output is on, from the cycle start
+} SlowPWM;
+
+void slowpwm_begin(SlowPWM *pwm, uint8_t pin, uint8_t onLevel, uint16_t period);
+void slowpwm_setHigh(SlowPWM *pwm, uint16_t high);
+void slowpwm_step(SlowPWM *pwm);
+
+#endif
@@ -0,0 +1,46 @@
+#include <Telemetry.h>
+#include <Crc8.h>
+
+static uint8_t *telemetry_put16(uint8_t *bytes, uint16_t value)
+{
+    *bytes++ = (uint8_t)value;
+    *bytes++ = (uint8_t)(value >> 8);
+    return bytes;
+}
+
+static uint16_t telemetry_get16(const uint8_t *bytes)
+{
+    return bytes[0] | ((uint16_t)bytes[1] << 8);
+}
+
+// Fill TELEMETRY_FRAME_SIZE bytes, field by field,
+// as STM8 is big endian and the frame is not
+void telemetry_encode(const TelemetryFrame *frame, uint8_t *bytes)
+{
+    uint8_t *out = bytes;
+    *out++ = TELEMETRY_SYNC;
+    out = telemetry_put16(out, (uint16_t)frame->time);
+    out = telemetry_put16(out, (uint16_t)(frame->time >> 16));
+    out = telemetry_put16(out, frame->raw);
+    out = telemetry_put16(out, frame->low);
+    out = telemetry_put16(out, frame->high);
+    out = telemetry_put16(out, frame->duty);
+    *out++ = frame->state;
+    *out = crc8(bytes + 1, TELEMETRY_FRAME_SIZE - 2);
+}
+
+// Return false if bytes are not a valid frame
+bool telemetry_decode(const uint8_t *bytes, TelemetryFrame *frame)
+{
+    if (bytes[0] != TELEMETRY_SYNC ||
+        bytes[TELEMETRY_FRAME_SIZE - 1] != crc8(bytes + 1, TELEMETRY_FRAME_SIZE - 2))
+        return false;
+
+    frame->time = telemetry_get16(bytes + 1) | ((uint32_t)telemetry_get16(bytes + 3) << 16);
+    frame->raw = (int16_t)telemetry_get16(bytes + 5);
+    frame->low = (int16_t)telemetry_get16(bytes + 7);
+    frame->high = (int16_t)telemetry_get16(bytes + 9);
+    frame->duty = telemetry_get16(bytes + 11);
+    frame->state = bytes[13];
+    return true;
+}
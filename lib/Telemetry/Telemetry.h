@@ -0,0 +1,45 @@
+// Fixed size binary frame with regulator state, for logging
+// over UART (see Uart.h) and decoding on the other end.
+//
+// Frame is 15 bytes, multi-byte fields are little endian:
+//   0      TELEMETRY_SYNC
+//   1..4   time, millis()
+//   5..6   raw sensor reading, sixteenths of degree
+//   7..8   low of the active slot, tenths of degree
+//   9..10  high of the active slot
+//   11..12 duty cycle, steps of output period
+//   13     state: active slot in low 4 bits, TELEMETRY_OUTPUT_ON
+//   14     Dallas CRC-8 of bytes 1..13
+// With 8N1 it takes 15.6 ms at 9600 baud, so 10 frames
+// per second leave the line idle a good part of the time.
+// Decoder looks for sync byte and checks CRC, on mismatch
+// it tries the next byte, so it finds its way in the middle
+// of the stream.
+// Nothing here depends on the board, decoder is built
+// from the same code (see tools/telemetry.c).
+
+#ifndef Telemetry_h
+#define Telemetry_h
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define TELEMETRY_FRAME_SIZE 15
+#define TELEMETRY_SYNC 0xA5
+#define TELEMETRY_OUTPUT_ON 0x80
+#define TELEMETRY_SLOT_MASK 0x0F
+
+typedef struct TelemetryFrame
+{
+    uint32_t time;
+    int16_t raw;
+    int16_t low;
+    int16_t high;
+    uint16_t duty;
+    uint8_t state;
+} TelemetryFrame;
+
+void telemetry_encode(const TelemetryFrame *frame, uint8_t *bytes);
+bool telemetry_decode(const uint8_t *bytes, TelemetryFrame *frame);
+
+#endif
@@ -0,0 +1,67 @@
+#include <TimerTick.h>
+
+// TIM2 counts at F_CPU / 2^TIMERTICK_PRESCALER (1 MHz on 16 MHz clock)
+#define TIMERTICK_PRESCALER 4
+
+typedef struct TimerTickSlot
+{
+    TimerTickHandler handler;
+    uint16_t divider;
+    uint16_t countdown;
+} TimerTickSlot;
+
+static TimerTickSlot slots[TIMERTICK_MAX_HANDLERS];
+static uint8_t numSlots;
+static uint16_t tickPeriod;
+
+// Start ticking every periodUs microseconds (1 to 65535),
+// with no handlers attached
+void timertick_begin(uint16_t periodUs)
+{
+    tickPeriod = periodUs;
+    numSlots = 0;
+
+    TIM2->CR1 = 0;
+    TIM2->PSCR = TIMERTICK_PRESCALER;
+    TIM2->ARRH = (uint8_t)((periodUs - 1) >> 8);
+    TIM2->ARRL = (uint8_t)(periodUs - 1);
+    TIM2->EGR = TIM2_EGR_UG; // Load prescaler right now
+    TIM2->SR1 = (uint8_t)~TIM2_SR1_UIF;
+    TIM2->IER = TIM2_IER_UIE;
+    TIM2->CR1 = TIM2_CR1_CEN;
+}
+
+// Tick period in microseconds, zero if ticking is not started
+uint16_t timertick_period(void)
+{
+    return tickPeriod;
+}
+
+// Call handler from interrupt every divider ticks,
+// return false if there is no free slot for it
+bool timertick_attach(TimerTickHandler handler, uint16_t divider)
+{
+    if (numSlots >= TIMERTICK_MAX_HANDLERS)
+        return false;
+
+    TimerTickSlot *slot = &slots[numSlots];
+    slot->handler = handler;
+    slot->divider = divider ? divider : 1;
+    slot->countdown = slot->divider;
+    numSlots++; // Slot is complete, interrupt may use it
+    return true;
+}
+
+INTERRUPT_HANDLER(TIM2_UPD_OVF_BRK_IRQHandler, 13)
+{
+    TIM2->SR1 = (uint8_t)~TIM2_SR1_UIF;
+
+    for (uint8_t slotNum = 0; slotNum < numSlots; slotNum++)
+    {
+        TimerTickSlot *slot = &slots[slotNum];
+        if (--slot->countdown)
+            continue;
+        slot->countdown = slot->divider;
+        slot->handler();
+    }
+}
@@ -0,0 +1,23 @@
+// Periodic TIM2 update interrupt shared by several handlers.
+//
+// STM8S103 has only three timers, and Sduino uses TIM4 for millis(),
+// so everything periodic that must not depend on the main loop
+// (display refresh, slow PWM output) hangs on this one interrupt.
+// Each handler is called every 'divider' ticks.
+
+#ifndef TimerTick_h
+#define TimerTick_h
+
+#include <Arduino.h>
+
+#ifndef TIMERTICK_MAX_HANDLERS
+#define TIMERTICK_MAX_HANDLERS 4
+#endif
+
+typedef void (*TimerTickHandler)(void);
+
+void timertick_begin(uint16_t periodUs);
+uint16_t timertick_period(void);
+bool timertick_attach(TimerTickHandler handler, uint16_t divider);
+
+#endif
@@ -0,0 +1,96 @@
+#include <Uart.h>
+
+#define UART_TX_MASK (UART_TX_SIZE - 1)
+
+// Main loop moves head, interrupt moves tail, indices run freely
+static uint8_t txBuffer[UART_TX_SIZE];
+static volatile uint8_t txHead;
+static volatile uint8_t txTail;
+static UartReceiveHandler receiveHandler;
+
+// Start transmitter with 8 data bits, no parity and 1 stop bit
+void uart_begin(uint32_t baud)
+{
+    uint16_t divider = (uint16_t)((F_CPU + baud / 2) / baud);
+    txHead = txTail = 0;
+    receiveHandler = NULL;
+
+    UART1->CR2 = 0;
+    UART1->CR1 = 0;
+    UART1->CR3 = 0;
+    // BRR2 must be written first, BRR1 write updates the divider
+    UART1->BRR2 = (uint8_t)(((divider >> 8) & 0xF0) | (divider & 0x0F));
+    UART1->BRR1 = (uint8_t)(divider >> 4);
+    UART1->CR2 = UART1_CR2_TEN;
+}
+
+// Listen on TX pin between transmissions,
+// handler is called from interrupt for every byte
+void uart_receive(UartReceiveHandler handler)
+{
+    receiveHandler = handler;
+    UART1->CR5 |= UART1_CR5_HDSEL;
+    UART1->CR2 |= UART1_CR2_RIEN | UART1_CR2_REN;
+}
+
+// Queue bytes for sending, return false (queueing nothing)
+// if they do not fit in the ring
+bool uart_write(const uint8_t *data, uint8_t size)
+{
+    uint8_t head = txHead;
+    if ((uint8_t)(UART_TX_SIZE - (uint8_t)(head - txTail)) < size)
+        return false;
+
+    for (uint8_t i = 0; i < size; i++)
+        txBuffer[(uint8_t)(head + i) & UART_TX_MASK] = data[i];
+    txHead = head + size; // Bytes are complete, interrupt may send them
+
+    // Receiver is off until the end, a pending transmission complete
+    // of the previous write must not turn it on meanwhile
+    noInterrupts();
+    uint8_t control = UART1->CR2 | UART1_CR2_TIEN;
+    if (receiveHandler)
+        control &= (uint8_t)~(UART1_CR2_REN | UART1_CR2_TCIEN);
+    UART1->CR2 = control;
+    interrupts();
+    return true;
+}
+
+// Bytes not yet taken by the transmitter
+uint8_t uart_pending(void)
+{
+    return txHead - txTail;
+}
+
+// Data register is empty: give it the next byte,
+// or stop interrupting if there is none.
+// Transmission is complete: listen again.
+INTERRUPT_HANDLER(UART1_TX_IRQHandler, 17)
+{
+    if ((UART1->CR2 & UART1_CR2_TCIEN) && (UART1->SR & UART1_SR_TC))
+    {
+        UART1->SR &= (uint8_t)~UART1_SR_TC;
+        UART1->CR2 = (UART1->CR2 & (uint8_t)~UART1_CR2_TCIEN) | UART1_CR2_REN;
+        return;
+    }
+
+    uint8_t tail = txTail;
+    if (tail == txHead)
+    {
+        UART1->CR2 &= (uint8_t)~UART1_CR2_TIEN;
+        if (receiveHandler)
+            UART1->CR2 |= UART1_CR2_TCIEN;
+        return;
+    }
+    UART1->DR = txBuffer[tail & UART_TX_MASK];
+    txTail = tail + 1;
+}
+
+// Status is read before data, which clears overrun with it
+INTERRUPT_HANDLER(UART1_RX_IRQHandler, 18)
+{
+    uint8_t status = UART1->SR;
+    uint8_t byte = UART1->DR;
+    if ((status & UART1_SR_RXNE) && receiveHandler)
+        receiveHandler(byte);
+}
@@ -0,0 +1,37 @@
+// Transmit side of UART1, driven by its TX interrupt.
+//
+// uart_write copies bytes to a ring and returns at once,
+// interrupt moves them to the data register one by one
+// while the line sends the previous one, and turns itself
+// off when the ring is empty. The main loop never waits
+// for the line, a write that does not fit is refused whole,
+// so the other end never gets a part of a message.
+//
+// After uart_receive the line is single wire half duplex
+// (for RS-485 adapter with automatic direction): receiver
+// listens on TX pin, and is turned off from the first byte
+// written until the stop bit of the last one, so it never
+// hears its own transmission. Received bytes are passed
+// to the handler from the RX interrupt.
+//
+// TX is PD5 (RX PD6, not used), pins of Sduino board are taken
+// by UART while it is enabled. Build with NO_SERIAL, Sduino Serial
+// defines the same interrupts.
+
+#ifndef Uart_h
+#define Uart_h
+
+#include <Arduino.h>
+
+#ifndef UART_TX_SIZE
+#define UART_TX_SIZE 32 // 2 to 128, power of two
+#endif
+
+typedef void (*UartReceiveHandler)(uint8_t byte);
+
+void uart_begin(uint32_t baud);
+void uart_receive(UartReceiveHandler handler);
+bool uart_write(const uint8_t *data, uint8_t size);
+uint8_t uart_pending(void);
+
+#endif
@@ -17,10 +17,84 @@ void microds_init(NanoDS18B20 *device, uint8_t dsPin)
 #ifndef nanods_NOPARASITE
     device->parasitePowered = parasitePowered;
 #endif
+#ifdef nanods_MULTI
+    device->rom = NULL;
+#endif
 
     pinMode(dsPin, INPUT);
 }
 
+// Address the device after reset: with MATCH ROM
+// if it has a code, otherwise with SKIP ROM
+static void microds_select(NanoDS18B20 *device)
+{
+#ifdef nanods_MULTI
+    if (device->rom)
+    {
+#ifndef nanods_NOPARASITE
+        oneWire_write(0x55, device->dsPin, false); // MATCH ROM
+        for (uint8_t i = 0; i < 8; i++)
+            oneWire_write(device->rom[i], device->dsPin, false);
+#else
+        oneWire_write(0x55, device->dsPin);
+        for (uint8_t i = 0; i < 8; i++)
+            oneWire_write(device->rom[i], device->dsPin);
+#endif
+        return;
+    }
+#endif
+
+#ifndef nanods_NOPARASITE
+    oneWire_write(0xCC, device->dsPin, false); // SKIP ROM
+#else
+    oneWire_write(0xCC, device->dsPin);
+#endif
+}
+
+#ifdef nanods_CRC
+// Scratchpad passes CRC and has bits which always read as 1
+// (all zeros from shorted line pass CRC)
+static bool microds_checkScratchpad(const uint8_t *scratchpad)
+{
+    return crc8(scratchpad, 9) == 0 && (scratchpad[4] & 0x1F) == 0x1F;
+}
+
+// 85 °C is power-on value, conversion did not happen,
+// reading it again won't help
+#define MICRODS_POWER_ON_RAW 0x0550
+#endif
+
+#ifdef nanods_MULTI
+// Find codes of up to maxCount DS18B20 on the pin, return how many found.
+// Other devices on the bus are skipped.
+uint8_t microds_search(uint8_t dsPin, uint8_t roms[][8], uint8_t maxCount)
+{
+    uint8_t rom[8];
+    uint8_t lastConflict = 0;
+    uint8_t count = 0;
+    while (count < maxCount && oneWire_search(dsPin, rom, &lastConflict))
+    {
+        if (rom[0] != 0x28) // DS18B20 family code
+            continue;
+#ifdef nanods_CRC
+        if (crc8(rom, 8) != 0)
+            continue;
+#endif
+        for (uint8_t i = 0; i < 8; i++)
+            roms[count][i] = rom[i];
+        count++;
+    }
+    return count;
+}
+
+// Talk to the sensor with this code (as found by search) only,
+// rom must remain valid. With NULL it is the only one on the pin.
+void microds_setAddress(NanoDS18B20 *device, const uint8_t *rom)
+{
+    device->rom = rom;
+}
+#endif
+
 #ifndef nanods_NORES
 // Set resolution, valid value range: 9<=res<=12
 // 9 bit -- 0.5 °С, 10 -- 0.25, 11 -- 0.125, 12 -- 0.0625
@@ -29,14 +103,13 @@ void microds_setResolution(NanoDS18B20 *device, uint8_t res)
     if (!oneWire_reset(device->dsPin)) // Initiate transaction
         return;
 
+    microds_select(device);
 #ifndef nanods_NOPARASITE
-    oneWire_write(0xCC, device->dsPin, false);                                      // SKIP ROM
     oneWire_write(0x4E, device->dsPin, false);                                      // WRITE SCRATCHPAD
     oneWire_write(0xFF, device->dsPin, false);                                      // Maximum value to Th register
     oneWire_write(0x00, device->dsPin, false);                                      // Minimum value to Tl register
     oneWire_write(((constrain(res, 9, 12) - 9) << 5) | 0x1F, device->dsPin, false); // Write configuration register
 #else
-    oneWire_write(0xCC, device->dsPin);
     oneWire_write(0x4E, device->dsPin);
     oneWire_write(0xFF, device->dsPin);
     oneWire_write(0x00, device->dsPin);
@@ -53,6 +126,9 @@ void microds_setResolution(NanoDS18B20 *device, uint8_t res)
 // If parasitePowered is true, pin will be left high,
 // and you MUST wait for conversion period before reading temperature.
 // If device has external power supply, you can poll readTemp.
+//
+// Conversion is started on all sensors of the pin at once (SKIP ROM),
+// so with nanods_MULTI call it for one of them, then readTemp for each.
 bool microds_requestTemp(NanoDS18B20 *device)
 {
     device->_tempUpdating = true;
@@ -70,7 +146,9 @@ bool microds_requestTemp(NanoDS18B20 *device)
     return true;
 }
 
-// Read first two registers from scratchpad (call requestTemp first)
+// Read first two registers from scratchpad (call requestTemp first),
+// or whole of it with nanods_CRC, then false is also returned
+// when it is still invalid after retries (previous temperature is kept)
 //
 // If device powered by external power source, you
 // can call this function during conversion, to determine
@@ -86,27 +164,129 @@ bool microds_readTemp(NanoDS18B20 *device)
 #endif
 
     device->_tempUpdating = false;
-    if (!oneWire_reset(device->dsPin))
+#ifdef nanods_CRC
+    for (uint8_t attempt = 0; attempt <= nanods_CRC_RETRIES; attempt++)
+#endif
     {
-        return false; // Sensor offline
-    }
+        if (!oneWire_reset(device->dsPin))
+        {
+            return false; // Sensor offline
+        }
 
+        microds_select(device);
 #ifndef nanods_NOPARASITE
-    oneWire_write(0xCC, device->dsPin, false); // SKIP ROM
-    oneWire_write(0xBE, device->dsPin, false); // READ SCRATCHPAD
+        oneWire_write(0xBE, device->dsPin, false); // READ SCRATCHPAD
 #else
-    oneWire_write(0xCC, device->dsPin); // SKIP ROM
-    oneWire_write(0xBE, device->dsPin); // READ SCRATCHPAD
+        oneWire_write(0xBE, device->dsPin); // READ SCRATCHPAD
 #endif
 
-    device->_buf = oneWire_read(device->dsPin);
-    device->_buf |= (oneWire_read(device->dsPin) << 8);
-    return true;
+#ifdef nanods_CRC
+        uint8_t scratchpad[9];
+        for (uint8_t i = 0; i < sizeof(scratchpad); i++)
+            scratchpad[i] = oneWire_read(device->dsPin);
+        if (!microds_checkScratchpad(scratchpad))
+            continue;
+        int16_t raw = scratchpad[0] | (scratchpad[1] << 8);
+        if (raw == MICRODS_POWER_ON_RAW)
+            return false;
+        device->_buf = raw;
+#else
+        device->_buf = oneWire_read(device->dsPin);
+        device->_buf |= (oneWire_read(device->dsPin) << 8);
+#endif
+        return true;
+    }
+#ifdef nanods_CRC
+    return false; // Every read was invalid
+#endif
+}
+
+#ifdef nanods_ASYNC
+// Same as requestTemp, but returns at once,
+// check with poll when transaction is over
+void microds_startRequest(NanoDS18B20 *device)
+{
+    static const uint8_t tx[] = {0xCC, 0x44}; // SKIP ROM, CONVERT T
+
+    device->_tempUpdating = true;
+    oneWire_start(device->dsPin, tx, sizeof(tx), NULL, 0);
+}
+
+static void microds_startScratchpad(NanoDS18B20 *device)
+{
+    static const uint8_t tx[] = {0xCC, 0xBE}; // SKIP ROM, READ SCRATCHPAD
+
+#ifdef nanods_MULTI
+    if (device->rom)
+    {
+        uint8_t matchTx[10]; // MATCH ROM, code, READ SCRATCHPAD
+        matchTx[0] = 0x55;
+        for (uint8_t i = 0; i < 8; i++)
+            matchTx[i + 1] = device->rom[i];
+        matchTx[9] = 0xBE;
+        oneWire_start(device->dsPin, matchTx, sizeof(matchTx), device->_rx, sizeof(device->_rx));
+        return;
+    }
+#endif
+    oneWire_start(device->dsPin, tx, sizeof(tx), device->_rx, sizeof(device->_rx));
 }
 
+// Same as readTemp, but returns at once,
+// temperature is updated when poll returns ONEWIRE_DONE.
+// Conversion status is not polled here, so wait
+// for conversion period after startRequest.
+void microds_startRead(NanoDS18B20 *device)
+{
+    device->_tempUpdating = false;
+#ifdef nanods_CRC
+    device->_retries = nanods_CRC_RETRIES;
+#endif
+    microds_startScratchpad(device);
+}
+
+// Check background transaction, see ONEWIRE_* for return values.
+// With nanods_CRC invalid read is started again while it stays
+// ONEWIRE_BUSY, and reported as ONEWIRE_NO_DEVICE after the last retry
+// (so is power-on value).
+uint8_t microds_poll(NanoDS18B20 *device)
+{
+    uint8_t state = oneWire_poll();
+    if (state != ONEWIRE_DONE || device->_tempUpdating)
+        return state;
+
+    int16_t raw = device->_rx[0] | (device->_rx[1] << 8);
+#ifdef nanods_CRC
+    if (!microds_checkScratchpad(device->_rx))
+    {
+        if (!device->_retries)
+            return ONEWIRE_NO_DEVICE;
+        device->_retries--;
+        microds_startScratchpad(device);
+        return ONEWIRE_BUSY;
+    }
+    if (raw == MICRODS_POWER_ON_RAW)
+        return ONEWIRE_NO_DEVICE;
+#endif
+    device->_buf = raw;
+    return state;
+}
+#endif
+
+// Get previously read temperature multiplied by 10,
+// rounded to nearest (call readTemp first)
+//
+// Raw value is in 1/16 °C, so there is no float
+// or division needed to convert it.
+int16_t microds_getTemp10(NanoDS18B20 *device)
+{
+    return (device->_buf * 10 + 8) >> 4;
+}
+
+#ifndef nanods_NOFLOAT
 // Get previously read temperature
 // (call readTemp first)
 float microds_getTemp(NanoDS18B20 *device)
 {
     return (device->_buf / 16.0);
 }
+#endif
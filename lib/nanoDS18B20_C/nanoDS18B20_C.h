@@ -1,8 +1,9 @@
 /*
     Small version of https://github.com/GyverLibs/NanoDS18B20 ported to C
 
-    Supports only one sensor on data pin.
-    Has no CRC data validation.
+    Supports only one sensor on data pin,
+    or several of them with nanods_MULTI.
+    Has no CRC data validation, unless nanods_CRC is defined.
 
     Original authors:
     Egor 'Nich1con' Zakharov & AlexGyver, alex@alexgyver.ru
@@ -15,6 +16,12 @@
 #include <Arduino.h>
 #include "nanoOneWire.h"
 
+// With nanods_CRC whole scratchpad is read and checked,
+// invalid read is repeated at once up to nanods_CRC_RETRIES times
+#if defined(nanods_CRC) && !defined(nanods_CRC_RETRIES)
+#define nanods_CRC_RETRIES 2
+#endif
+
 typedef struct NanoDS18B20
 {
     char dsPin;
@@ -26,6 +33,19 @@ typedef struct NanoDS18B20
 
     int16_t _buf;
     uint8_t _tempUpdating;
+
+#ifdef nanods_ASYNC
+#ifdef nanods_CRC
+    uint8_t _rx[9]; // Scratchpad read in background
+    uint8_t _retries;
+#else
+    uint8_t _rx[2]; // Scratchpad bytes read in background
+#endif
+#endif
+
+#ifdef nanods_MULTI
+    const uint8_t *rom; // Code of the sensor, NULL if it is alone on the pin
+#endif
 } NanoDS18B20;
 
 #ifndef nanods_NOPARASITE
@@ -34,12 +54,26 @@ void microds_init(NanoDS18B20 *device, uint8_t dsPin, bool parasitePowered);
 void microds_init(NanoDS18B20 *device, uint8_t dsPin);
 #endif
 
+#ifdef nanods_MULTI
+uint8_t microds_search(uint8_t dsPin, uint8_t roms[][8], uint8_t maxCount);
+void microds_setAddress(NanoDS18B20 *device, const uint8_t *rom);
+#endif
+
 #ifndef nanods_NORES
 void microds_setResolution(NanoDS18B20 *device, uint8_t res);
 #endif
 
 bool microds_requestTemp(NanoDS18B20 *device);
 bool microds_readTemp(NanoDS18B20 *device);
+
+#ifdef nanods_ASYNC
+void microds_startRequest(NanoDS18B20 *device);
+void microds_startRead(NanoDS18B20 *device);
+uint8_t microds_poll(NanoDS18B20 *device);
+#endif
+int16_t microds_getTemp10(NanoDS18B20 *device);
+#ifndef nanods_NOFLOAT
 float microds_getTemp(NanoDS18B20 *device);
+#endif
 
 #endif
@@ -22,21 +22,162 @@
     }
 #endif
 
+// Delays of the slots
+#ifdef nanods_CALIBRATE
+#define __ow_resetLow() __ow_delay_us(oneWire_timing.resetLow)
+#define __ow_resetSample() __ow_delay_us(oneWire_timing.resetSample)
+#define __ow_resetRest() __ow_delay_us(oneWire_timing.resetRest)
+#define __ow_writeLow0() __ow_delay_us(oneWire_timing.writeLow0)
+#define __ow_writeLow1() __ow_delay_us(oneWire_timing.writeLow1)
+#define __ow_writeRest1() __ow_delay_us(oneWire_timing.writeRest1)
+#define __ow_readLow() __ow_delay_us(oneWire_timing.readLow)
+#define __ow_readRest() __ow_delay_us(oneWire_timing.readRest)
+#define __ow_recovery() __ow_delay_us(oneWire_timing.recovery)
+#else
+// delayMicroseconds overhead is around 30us,
+// so in total reset is longer than 480us
+// (it uses less memory, so i use it where timing not critical)
+#define __ow_resetLow() delayMicroseconds(450)
+#define __ow_resetSample() __ow_delay_us(65)
+#define __ow_resetRest() delayMicroseconds(400)
+#define __ow_writeLow0() delayMicroseconds(40)
+#define __ow_writeLow1() NOP_MICROSECOND()
+#define __ow_writeRest1() delayMicroseconds(40)
+#define __ow_readLow() __ow_delay_us(2)
+#define __ow_readRest() __ow_delay_us(40)
+#define __ow_recovery() __ow_delay_us(5)
+#endif
+
+#ifdef nanods_CALIBRATE
+// Minimums of DS18B20 datasheet, in us
+#define OW_RESET_LOW_US 480
+#define OW_PRESENCE_US 480
+#define OW_RESET_SAMPLE_US 65 // presence pulse is on from 60 to 75 us
+#define OW_SLOT_US 60
+#define OW_LOW_US 1 // of write 1 and read slots
+#define OW_RECOVERY_US 1
+
+#define OW_CYCLES_PER_US (F_CPU / 1000000)
+#define OW_CALIBRATE_LOOPS 64
+#define OW_CALIBRATE_RUNS 4
+
+OneWireTiming oneWire_timing;
+
+static uint16_t owLoopCycles; // Of OW_CALIBRATE_LOOPS iterations
+static uint16_t owLoopFixed;  // Of the loop with no iterations
+
+// CPU cycles, TIM1 counts them while calibrating
+static uint16_t oneWire_cycles(void)
+{
+    // high byte is read first, it latches the low one
+    uint8_t high = TIM1->CNTRH;
+    return ((uint16_t)high << 8) | TIM1->CNTRL;
+}
+
+// Keep the shortest time since start, interrupts
+// can only make it longer
+static void oneWire_keepShortest(uint16_t *shortest, uint16_t start)
+{
+    uint16_t elapsed = oneWire_cycles() - start;
+    if (elapsed < *shortest)
+        *shortest = elapsed;
+}
+
+// Loop count of at least us, of which overhead cycles
+// are taken by pin calls next to the delay
+static uint16_t oneWire_loopCount(uint16_t us, uint16_t overhead)
+{
+    uint16_t cycles = us * OW_CYCLES_PER_US;
+    overhead += owLoopFixed;
+    if (cycles <= overhead)
+        return 0;
+    return ((uint32_t)(cycles - overhead) * OW_CALIBRATE_LOOPS + owLoopCycles - 1) / owLoopCycles;
+}
+
+// Measure delay loop and pin calls on idle line, set oneWire_timing
+void oneWire_calibrate(uint8_t pin)
+{
+    __ow_delay_us_used;
+    uint16_t loops = 0;
+
+    TIM1->CR1 = 0;
+    TIM1->IER = 0;
+    TIM1->PSCRH = 0;
+    TIM1->PSCRL = 0;
+    TIM1->ARRH = 0xFF;
+    TIM1->ARRL = 0xFF;
+    TIM1->EGR = TIM1_EGR_UG; // Load prescaler right now
+    TIM1->CR1 = TIM1_CR1_CEN;
+
+    uint16_t timer = UINT16_MAX;
+    uint16_t loopNone = UINT16_MAX;
+    uint16_t loopAll = UINT16_MAX;
+    uint16_t pinModeCycles = UINT16_MAX;
+    uint16_t digitalReadCycles = UINT16_MAX;
+    uint16_t digitalWriteCycles = UINT16_MAX;
+    pinMode(pin, INPUT);
+    for (uint8_t run = 0; run < OW_CALIBRATE_RUNS; run++)
+    {
+        uint16_t start = oneWire_cycles();
+        oneWire_keepShortest(&timer, start);
+
+        start = oneWire_cycles();
+        __ow_delay_us(loops);
+        oneWire_keepShortest(&loopNone, start);
+        loops = OW_CALIBRATE_LOOPS;
+        start = oneWire_cycles();
+        __ow_delay_us(loops);
+        oneWire_keepShortest(&loopAll, start);
+        loops = 0;
+
+        // line stays released, as between transactions
+        start = oneWire_cycles();
+        pinMode(pin, INPUT);
+        oneWire_keepShortest(&pinModeCycles, start);
+        start = oneWire_cycles();
+        digitalRead(pin);
+        oneWire_keepShortest(&digitalReadCycles, start);
+        start = oneWire_cycles();
+        digitalWrite(pin, LOW);
+        oneWire_keepShortest(&digitalWriteCycles, start);
+    }
+    TIM1->CR1 = 0;
+
+    owLoopCycles = loopAll - loopNone;
+    owLoopFixed = loopNone - timer;
+    pinModeCycles -= timer;
+    digitalReadCycles -= timer;
+    digitalWriteCycles -= timer;
+
+    // low is from pinMode to pinMode, sample is in digitalRead
+    oneWire_timing.resetLow = oneWire_loopCount(OW_RESET_LOW_US, pinModeCycles);
+    oneWire_timing.resetSample = oneWire_loopCount(OW_RESET_SAMPLE_US, digitalReadCycles);
+    oneWire_timing.resetRest = oneWire_loopCount(OW_PRESENCE_US - OW_RESET_SAMPLE_US, 0);
+    oneWire_timing.writeLow0 = oneWire_loopCount(OW_SLOT_US, pinModeCycles);
+    oneWire_timing.writeLow1 = oneWire_loopCount(OW_LOW_US, pinModeCycles);
+    oneWire_timing.writeRest1 = oneWire_loopCount(OW_SLOT_US - OW_LOW_US, pinModeCycles);
+    oneWire_timing.readLow = oneWire_loopCount(OW_LOW_US, pinModeCycles);
+    oneWire_timing.readRest = oneWire_loopCount(OW_SLOT_US - OW_LOW_US, pinModeCycles + digitalReadCycles);
+    oneWire_timing.recovery = oneWire_loopCount(OW_RECOVERY_US, digitalWriteCycles);
+}
+#endif
+
 // Pull data line low and see if device will do the same in response
 bool oneWire_reset(uint8_t pin)
 {
+    __ow_delay_us_used;
+
     pinMode(pin, OUTPUT);
     digitalWrite(pin, LOW);
-    // delayMicroseconds overhead is around 30us,
-    // so in total time more than 480us
-    // (it uses less memory, so i use it where timing not critical)
-    delayMicroseconds(450);
+    __ow_resetLow();
 
+    // interrupt between release and sample could miss presence pulse
+    noInterrupts();
     pinMode(pin, INPUT);
-    __ow_delay_us_used;
-    __ow_delay_us(65);
+    __ow_resetSample();
     bool devicePulledLow = !digitalRead(pin);
-    delayMicroseconds(400);
+    interrupts();
+    __ow_resetRest();
 
     return devicePulledLow;
 }
@@ -53,33 +194,39 @@ void oneWire_write(uint8_t data, uint8_t pin)
     digitalWrite(pin, LOW);
     for (uint8_t i = 8; i; i--)
     {
+        // interrupt while line is low could make 1 look like 0
+        noInterrupts();
         pinMode(pin, OUTPUT);
         if (data & 1)
         {
 #ifndef nanods_NOPARASITE
-            NOP_MICROSECOND();
+            __ow_writeLow1();
             if (i != 1 || !leavePowered)
             {
                 pinMode(pin, INPUT);
-                delayMicroseconds(40);
+                interrupts();
+                __ow_writeRest1();
             }
             else
             {
                 digitalWrite(pin, HIGH);
+                interrupts();
             }
 #else
-            NOP_MICROSECOND();
+            __ow_writeLow1();
             pinMode(pin, INPUT);
-            delayMicroseconds(40);
+            interrupts();
+            __ow_writeRest1();
 #endif
         }
         else
         {
-            delayMicroseconds(40);
+            __ow_writeLow0();
             pinMode(pin, INPUT);
+            interrupts();
         }
         data >>= 1;
-        __ow_delay_us(5);
+        __ow_recovery();
     }
 }
 
@@ -88,13 +235,17 @@ bool oneWire_readBit(uint8_t pin)
 {
     __ow_delay_us_used;
 
+    // device holds 0 for 15 us from the falling edge,
+    // interrupt before the sample could make it read as 1
+    noInterrupts();
     digitalWrite(pin, LOW);
     pinMode(pin, OUTPUT);
-    __ow_delay_us(2);
+    __ow_readLow();
     pinMode(pin, INPUT);
 
     bool resp = digitalRead(pin);
-    __ow_delay_us(40);
+    interrupts();
+    __ow_readRest();
     return resp;
 }
 
@@ -109,4 +260,251 @@ uint8_t oneWire_read(uint8_t pin)
             data |= (1 << 7);
     }
     return data;
-}
\ No newline at end of file
+}
+
+#ifdef nanods_MULTI
+// Do 1 WRITE time slot, line is released after it
+static void oneWire_writeBit(uint8_t pin, bool bit)
+{
+    __ow_delay_us_used;
+
+    noInterrupts();
+    digitalWrite(pin, LOW);
+    pinMode(pin, OUTPUT);
+    if (bit)
+    {
+        __ow_writeLow1();
+        pinMode(pin, INPUT);
+        interrupts();
+        __ow_writeRest1();
+    }
+    else
+    {
+        __ow_writeLow0();
+        pinMode(pin, INPUT);
+        interrupts();
+    }
+    __ow_recovery();
+}
+
+// Find the next device on the bus with SEARCH ROM.
+//
+// rom is code found by previous call, it's replaced with the next one.
+// lastConflict keeps position where search goes other way next time,
+// set it to zero before the first call.
+// Returns false when all devices are found, or nobody answered.
+bool oneWire_search(uint8_t pin, uint8_t *rom, uint8_t *lastConflict)
+{
+    if (*lastConflict == 0xFF) // Previous device was the last one
+        return false;
+    if (!oneWire_reset(pin))
+        return false;
+
+#ifndef nanods_NOPARASITE
+    oneWire_write(0xF0, pin, false); // SEARCH ROM
+#else
+    oneWire_write(0xF0, pin);
+#endif
+
+    // Devices send every bit of their codes and then its complement,
+    // zero wins on the line, so 0 and 0 means they disagree.
+    // Master picks the way and devices which don't match drop out.
+    uint8_t conflict = 0;
+    for (uint8_t bitNum = 1; bitNum <= 64; bitNum++)
+    {
+        uint8_t *romByte = &rom[(bitNum - 1) >> 3];
+        uint8_t mask = 1 << ((bitNum - 1) & 7);
+        bool bit = oneWire_readBit(pin);
+        bool complement = oneWire_readBit(pin);
+        if (bit && complement)
+            return false; // Nobody is left
+
+        if (bit == complement)
+        {
+            // Same way as before until the last conflict, there turn to 1
+            if (bitNum < *lastConflict)
+                bit = *romByte & mask;
+            else
+                bit = (bitNum == *lastConflict);
+            if (!bit)
+                conflict = bitNum;
+        }
+
+        if (bit)
+            *romByte |= mask;
+        else
+            *romByte &= ~mask;
+        oneWire_writeBit(pin, bit);
+    }
+
+    *lastConflict = conflict ? conflict : 0xFF;
+    return true;
+}
+#endif
+
+#ifdef nanods_ASYNC
+// One tick of TIM1 is one time slot, 70 us
+// (TIM1 counts microseconds with prescaler 16 on 16 MHz clock)
+#define OW_TICK_US 70
+#define OW_TICK_PRESCALER (F_CPU / 1000000 - 1)
+
+// Reset takes 15 ticks: line is held low for 7 of them (490 us),
+// presence pulse is sampled on 9th, 490 us after release it's over
+#define OW_RESET_RELEASE_TICK 8
+#define OW_RESET_SAMPLE_TICK 9
+#define OW_RESET_END_TICK 15
+
+#define OW_STEP_RESET 0
+#define OW_STEP_WRITE 1
+#define OW_STEP_READ 2
+#define OW_STEP_FINISH 3
+
+static volatile uint8_t owState = ONEWIRE_IDLE;
+static uint8_t owStep;
+static uint8_t owPin;
+static uint8_t owTx[ONEWIRE_TX_MAX];
+static uint8_t owTxLen;
+static uint8_t *owRx;
+static uint8_t owRxLen;
+static uint8_t owByte; // Index of current byte
+static uint8_t owBit;  // Mask of current bit, also tick counter of reset
+static bool owHeldLow; // Write 0 slot started on previous tick
+
+// Start transaction: reset, writing txLen bytes from tx
+// and reading rxLen bytes to rx (rx must remain valid until done).
+// Returns at once, check result with oneWire_poll.
+void oneWire_start(uint8_t pin, const uint8_t *tx, uint8_t txLen, uint8_t *rx, uint8_t rxLen)
+{
+    TIM1->CR1 = 0;
+
+    owPin = pin;
+    owTxLen = min(txLen, ONEWIRE_TX_MAX);
+    for (uint8_t i = 0; i < owTxLen; i++)
+        owTx[i] = tx[i];
+    owRx = rx;
+    owRxLen = rxLen;
+    owStep = OW_STEP_RESET;
+    owBit = 0;
+    owHeldLow = false;
+    owState = ONEWIRE_BUSY;
+
+    TIM1->PSCRH = (uint8_t)(OW_TICK_PRESCALER >> 8);
+    TIM1->PSCRL = (uint8_t)(OW_TICK_PRESCALER);
+    TIM1->ARRH = 0;
+    TIM1->ARRL = OW_TICK_US - 1;
+    TIM1->EGR = TIM1_EGR_UG; // Load prescaler right now
+    TIM1->SR1 = (uint8_t)~TIM1_SR1_UIF;
+    TIM1->IER = TIM1_IER_UIE;
+    TIM1->CR1 = TIM1_CR1_CEN;
+}
+
+// Get state of transaction, ONEWIRE_DONE and ONEWIRE_NO_DEVICE
+// are returned once, then it's ONEWIRE_IDLE
+uint8_t oneWire_poll(void)
+{
+    uint8_t state = owState;
+    if (state == ONEWIRE_DONE || state == ONEWIRE_NO_DEVICE)
+        owState = ONEWIRE_IDLE;
+    return state;
+}
+
+static void oneWire_finish(uint8_t state)
+{
+    TIM1->CR1 = 0;
+    owState = state;
+}
+
+// Move to the next bit, and to the next step after last byte
+static void oneWire_nextBit(uint8_t bytesLen, uint8_t nextStep)
+{
+    owBit <<= 1;
+    if (owBit)
+        return;
+    owBit = 1;
+    if (++owByte < bytesLen)
+        return;
+    owByte = 0;
+    owStep = nextStep;
+}
+
+// Do one time slot (or one tick of reset)
+static void oneWire_tick(void)
+{
+    __ow_delay_us_used;
+
+    // End write 0 slot, 70 us after it started
+    if (owHeldLow)
+    {
+        pinMode(owPin, INPUT);
+        owHeldLow = false;
+        __ow_delay_us(2); // Recovery between slots
+    }
+
+    if (owStep == OW_STEP_RESET)
+    {
+        owBit++;
+        if (owBit == 1)
+        {
+            digitalWrite(owPin, LOW);
+            pinMode(owPin, OUTPUT);
+        }
+        else if (owBit == OW_RESET_RELEASE_TICK)
+        {
+            pinMode(owPin, INPUT);
+        }
+        else if (owBit == OW_RESET_SAMPLE_TICK)
+        {
+            if (digitalRead(owPin))
+                oneWire_finish(ONEWIRE_NO_DEVICE);
+        }
+        else if (owBit == OW_RESET_END_TICK)
+        {
+            owByte = 0;
+            owBit = 1;
+            owStep = owTxLen ? OW_STEP_WRITE : (owRxLen ? OW_STEP_READ : OW_STEP_FINISH);
+        }
+        return;
+    }
+
+    if (owStep == OW_STEP_WRITE)
+    {
+        digitalWrite(owPin, LOW);
+        pinMode(owPin, OUTPUT);
+        if (owTx[owByte] & owBit)
+        {
+            __ow_writeLow1();
+            pinMode(owPin, INPUT);
+        }
+        else
+        {
+            owHeldLow = true;
+        }
+        oneWire_nextBit(owTxLen, owRxLen ? OW_STEP_READ : OW_STEP_FINISH);
+        return;
+    }
+
+    if (owStep == OW_STEP_READ)
+    {
+        digitalWrite(owPin, LOW);
+        pinMode(owPin, OUTPUT);
+        __ow_readLow();
+        pinMode(owPin, INPUT);
+
+        if (owBit == 1)
+            owRx[owByte] = 0;
+        if (digitalRead(owPin))
+            owRx[owByte] |= owBit;
+        oneWire_nextBit(owRxLen, OW_STEP_FINISH);
+        return;
+    }
+
+    // Line is released at this point
+    oneWire_finish(ONEWIRE_DONE);
+}
+
+INTERRUPT_HANDLER(TIM1_UPD_OVF_TRG_BRK_IRQHandler, 11)
+{
+    TIM1->SR1 = (uint8_t)~TIM1_SR1_UIF;
+    oneWire_tick();
+}
+#endif
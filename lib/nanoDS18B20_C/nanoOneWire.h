@@ -8,6 +8,7 @@
 // of DS18B20. Call readBit 2 times in series and
 // redefine NOP_MICROSECOND in such way that
 // distance between two voltage drops became around 70 microseconds.
+// Or define nanods_CALIBRATE to have it measured at startup.
 
 #ifndef _microOneWire_h
 #define _microOneWire_h
@@ -24,4 +25,69 @@ void oneWire_write(uint8_t data, uint8_t pin, bool leavePowered);
 void oneWire_write(uint8_t data, uint8_t pin);
 #endif
 
+// Define nanods_CALIBRATE to time delays of the slots by measurement
+// instead of NOP_MICROSECOND: oneWire_calibrate counts CPU cycles
+// of the delay loop and of pin calls with TIM1 and sets loop counts,
+// so slots are cut to the minimum of the spec for any clock
+// and compiler flags. Call it once before the first transaction,
+// TIM1 is stopped after it.
+#ifdef nanods_CALIBRATE
+typedef struct OneWireTiming
+{
+    // Loop counts of __ow_delay_us
+    uint16_t resetLow;    // Reset pulse
+    uint16_t resetSample; // From release to presence sample
+    uint16_t resetRest;   // From sample to the end of presence
+    uint16_t writeLow0;   // Write 0 slot
+    uint16_t writeLow1;   // Low part of write 1 slot
+    uint16_t writeRest1;  // Rest of write 1 slot
+    uint16_t readLow;     // Low part of read slot
+    uint16_t readRest;    // From sample to the end of read slot
+    uint16_t recovery;    // Between slots
+} OneWireTiming;
+
+extern OneWireTiming oneWire_timing;
+
+void oneWire_calibrate(uint8_t pin);
+#endif
+
+// Define nanods_CRC to validate data with Dallas CRC-8 (see Crc8.h)
+#ifdef nanods_CRC
+#include <Crc8.h>
+#endif
+
+// Define nanods_MULTI to address several sensors on one pin
+// by their ROM codes (see oneWire_search)
+#ifdef nanods_MULTI
+bool oneWire_search(uint8_t pin, uint8_t *rom, uint8_t *lastConflict);
+#endif
+
+// Define nanods_ASYNC to make transactions in background:
+// TIM1 update interrupt does one time slot per tick,
+// so nothing blocks for longer than a few microseconds.
+#ifdef nanods_ASYNC
+#ifndef nanods_NOPARASITE
+#error "nanods_ASYNC supports only externally powered sensors, define nanods_NOPARASITE"
+#endif
+
+// State of the background transaction
+#define ONEWIRE_IDLE 0      // Nothing started, or result is already taken
+#define ONEWIRE_BUSY 1      // Transaction is in progress
+#define ONEWIRE_DONE 2      // Transaction completed
+#define ONEWIRE_NO_DEVICE 3 // Nobody answered reset pulse
+
+// Most bytes one transaction can write
+// (MATCH ROM with the code and command is 10 bytes)
+#ifndef ONEWIRE_TX_MAX
+#ifdef nanods_MULTI
+#define ONEWIRE_TX_MAX 10
+#else
+#define ONEWIRE_TX_MAX 2
+#endif
+#endif
+
+void oneWire_start(uint8_t pin, const uint8_t *tx, uint8_t txLen, uint8_t *rx, uint8_t rxLen);
+uint8_t oneWire_poll(void);
+#endif
+
 #endif
@@ -0,0 +1,130 @@
+// End to end check of relay auto-tuning against simulated plant.
+//
+// Firmware built with -DTempControl_AUTOTUNE regulates heater
+// in a vessel (see host_plant.c) from cold start twice:
+// first in PID mode with gains derived from slot range,
+// then relay test is started from the menu, as user would do it,
+// and the same slot is regulated with gains found by the test.
+// For each run overshoot and error of the last hour are reported.
+//
+// usage: autotune [dead time in seconds [time constant in seconds]]
+// exit status is non-zero if test fails, or tuned PID is off,
+// or it regulates worse than range gains (more overshoot or error)
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <host.h>
+#include <Firmware.h>
+
+#define SIM_AMBIENT 15.0f
+#define SIM_SETPOINT 25.0f // middle of default slot
+#define SIM_REGULATE_MS 7200000UL
+#define SIM_TUNE_MAX_MS 14400000UL
+#define SIM_MAX_ERROR 0.3
+
+static HostPlant plant = {SIM_AMBIENT, 40, 300, 20, 0, 0, LOW};
+
+typedef struct SimScore
+{
+    float overshoot;
+    float meanError; // absolute, over the last hour
+} SimScore;
+
+static void pressButtons(bool up, bool down, uint32_t ms)
+{
+    host_setInput(buttonUpPin, up ? LOW : HIGH);
+    host_setInput(buttonDownPin, down ? LOW : HIGH);
+    host_runFor(ms);
+    host_setInput(buttonUpPin, HIGH);
+    host_setInput(buttonDownPin, HIGH);
+    host_runFor(300);
+}
+
+static SimScore regulate(uint32_t ms)
+{
+    SimScore score = {0, 0};
+    uint32_t samples = 0;
+    uint32_t start = millis();
+    uint32_t next = start;
+    while (millis() - start < ms)
+    {
+        loop();
+        if (millis() < next)
+            continue;
+        next += 1000;
+        float error = host_plant_temperature() - SIM_SETPOINT;
+        if (error > score.overshoot)
+            score.overshoot = error;
+        if (millis() - start >= ms - 3600000)
+        {
+            score.meanError += error < 0 ? -error : error;
+            samples++;
+        }
+    }
+    score.meanError /= samples;
+    return score;
+}
+
+static void start(void)
+{
+    host_reset();
+    host_ds18b20_attach(tempSensorPin);
+    plant.pin = outputPin;
+    host_plant_attach(&plant, SIM_AMBIENT);
+    setup();
+    host_runFor(1000);
+}
+
+int main(int argc, char **argv)
+{
+    if (argc > 1)
+        plant.deadTime = atof(argv[1]);
+    if (argc > 2)
+        plant.timeConstant = atof(argv[2]);
+    printf("plant: %.0f C rise, %.0f s time constant, %.0f s dead time\n",
+           plant.gain, plant.timeConstant, plant.deadTime);
+
+    start();
+    tempControlPidSlots = 1;
+    SimScore rangeScore = regulate(SIM_REGULATE_MS);
+    printf("range gains: overshoot %.2f C, mean error %.3f C\n",
+           rangeScore.overshoot, rangeScore.meanError);
+
+    // open slot menu, switch slot 1 to PID, then to relay test
+    start();
+    pressButtons(true, false, 100);
+    pressButtons(true, true, 100);
+    pressButtons(true, true, 400);
+    pressButtons(true, true, 400);
+    host_runFor(3000);
+    if (menuState != MenuState_AUTOTUNE)
+    {
+        printf("relay test has not started from the menu\n");
+        return 1;
+    }
+
+    uint32_t tuneStart = millis();
+    while (menuState == MenuState_AUTOTUNE && millis() - tuneStart < SIM_TUNE_MAX_MS)
+        loop();
+    if (tune.state != RELAYTUNE_DONE)
+    {
+        printf("relay test failed\n");
+        return 1;
+    }
+    printf("relay test: %.0f s, ultimate gain %.2f %%/C, ultimate period %u updates\n",
+           (millis() - tuneStart) / 1000.0,
+           tune.ultimateGain * 100.0 / 256 / tune.outputOn * 10,
+           tune.ultimatePeriod);
+
+    // stored gains are used after power cycle
+    host_plant_attach(&plant, SIM_AMBIENT);
+    setup();
+    SimScore tunedScore = regulate(SIM_REGULATE_MS);
+    printf("tuned gains: overshoot %.2f C, mean error %.3f C\n",
+           tunedScore.overshoot, tunedScore.meanError);
+
+    bool worse = tunedScore.overshoot > rangeScore.overshoot || tunedScore.meanError > rangeScore.meanError;
+    bool ok = tunedScore.meanError <= SIM_MAX_ERROR && !worse;
+    printf("%s\n", ok ? "ok" : (worse ? "FAILED, tuned gains are worse" : "FAILED"));
+    return ok ? 0 : 1;
+}
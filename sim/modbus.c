@@ -0,0 +1,191 @@
+// Modbus RTU slave against master (tools/modbus.c) through a pty.
+//
+// Bytes master writes to the pty come to simulated UART receiver
+// at 9600 baud, and answer bytes go back to the pty as they are sent.
+// Before master starts, a request to other slave and a request with
+// broken CRC are sent, neither may be answered. Master then reads
+// and writes registers, and firmware must end with values written
+// (in RAM and in settings log). Turnaround, from the stop bit
+// of the last request byte to the start bit of the first answer
+// byte, is measured in simulated time and checked against the budget.
+//
+// usage: modbus [master], master is the one built by
+// native_modbus_master environment by default
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <host.h>
+#include <Firmware.h>
+// after host.h, it defines CR1 and others as macros
+#include <fcntl.h>
+#include <termios.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#define SIM_AMBIENT 15.0f
+#define SIM_CHAR_NS (10 * 1000000000ULL / 9600)
+// Frame end takes 3.5 characters (3.6 ms), the rest is processing
+#define SIM_TURNAROUND_MS 10
+#define SIM_TIMEOUT_S 60 // of real time, master runs in it
+#define SIM_MASTER ".pio/build/native_modbus_master/program"
+#define SIM_POLLS 200 // reads of temperature, some of them hit sensor reads
+
+static HostPlant plant = {SIM_AMBIENT, 40, 300, 5, 30, 0, LOW};
+
+static int master = -1;
+static uint64_t requestEnd; // stop bit of the last byte queued to receiver
+static bool awaiting;
+static uint32_t answers, answerBytes;
+static uint64_t turnaroundMax, turnaroundTotal;
+
+static void sendByte(uint8_t byte)
+{
+    answerBytes++;
+    if (awaiting)
+    {
+        // called after the stop bit, answer started a character earlier
+        uint64_t turnaround = host_ns - SIM_CHAR_NS - requestEnd;
+        if (turnaround > turnaroundMax)
+            turnaroundMax = turnaround;
+        turnaroundTotal += turnaround;
+        answers++;
+        awaiting = false;
+    }
+    if (master >= 0 && write(master, &byte, 1) != 1)
+        perror("pty");
+}
+
+static void receive(const uint8_t *data, uint16_t size)
+{
+    uint64_t start = requestEnd > host_ns ? requestEnd : host_ns;
+    requestEnd = start + size * SIM_CHAR_NS;
+    host_uartReceive(data, size);
+    awaiting = true;
+}
+
+static uint16_t crc16(const uint8_t *data, uint8_t size)
+{
+    uint16_t crc = 0xFFFF;
+    while (size--)
+    {
+        crc ^= *data++;
+        for (uint8_t bit = 0; bit < 8; bit++)
+            crc = (crc & 1) ? (crc >> 1) ^ 0xA001 : crc >> 1;
+    }
+    return crc;
+}
+
+int main(int argc, char **argv)
+{
+    const char *masterPath = argc > 1 ? argv[1] : SIM_MASTER;
+
+    host_reset();
+    host_ds18b20_attach(tempSensorPin);
+    plant.pin = outputPin;
+    host_plant_attach(&plant, SIM_AMBIENT);
+    setup();
+    host_onUartTx = sendByte;
+    host_runFor(1000);
+    TempControlSlot untouched = tempControlSlots[3];
+
+    // read of slot, to slave 2, and the same to us with CRC broken
+    uint8_t other[8] = {2, 3, 0, 0, 0, 1};
+    uint16_t crc = crc16(other, 6);
+    other[6] = (uint8_t)crc;
+    other[7] = (uint8_t)(crc >> 8);
+    receive(other, 8);
+    host_runFor(100);
+    other[0] = 1;
+    receive(other, 8);
+    host_runFor(100);
+    bool ignored = !answerBytes;
+    awaiting = false;
+
+    master = posix_openpt(O_RDWR | O_NOCTTY);
+    if (master < 0 || grantpt(master) || unlockpt(master))
+    {
+        perror("pty");
+        return 1;
+    }
+    const char *slaveName = ptsname(master);
+    fcntl(master, F_SETFL, O_NONBLOCK);
+
+    char outName[] = "/tmp/modbusXXXXXX";
+    int out = mkstemp(outName);
+    pid_t child = fork();
+    if (!child)
+    {
+        dup2(out, STDOUT_FILENO);
+        close(out);
+        close(master);
+        // slot 3, its range, then values out of range (alone and after
+        // a valid one, which must not be written) and a missing register
+        const char *args[16 + SIM_POLLS] = {
+            masterPath, slaveName, "1",
+            "r:0:13", "i:0:3", "w:0:2", "W:5:-125,-75", "r:0:1", "r:5:2",
+            "w:6:2000", "W:7:150,2000", "r:99:1"};
+        uint16_t count = 12;
+        for (uint16_t i = 0; i < SIM_POLLS; i++)
+            args[count++] = "i:0:1";
+        args[count] = NULL;
+        execv(masterPath, (char *const *)args);
+        perror(masterPath);
+        _exit(1);
+    }
+
+    // simulated time runs while master waits, bytes come when it writes them
+    int status = 0;
+    bool exited = false;
+    time_t deadline = time(NULL) + SIM_TIMEOUT_S;
+    while (!exited && time(NULL) < deadline)
+    {
+        uint8_t request[64];
+        ssize_t got = read(master, request, sizeof(request));
+        if (got > 0)
+            receive(request, got);
+        for (uint8_t i = 0; i < 10; i++)
+            loop();
+        exited = waitpid(child, &status, WNOHANG) == child;
+    }
+    if (!exited)
+    {
+        kill(child, SIGKILL);
+        waitpid(child, &status, 0);
+    }
+    close(master);
+    master = -1;
+
+    FILE *lines = fopen(outName, "r");
+    char line[256];
+    uint16_t lineNum = 0;
+    while (fgets(line, sizeof(line), lines))
+    {
+        if (lineNum++ < 9)
+            printf("  %s", line);
+    }
+    printf("  ... and %u polls\n", lineNum > 9 ? lineNum - 9 : 0);
+    fclose(lines);
+    unlink(outName);
+
+    TempControlSlot stored;
+    bool saved = settingslog_read(&settings, 2, &stored, sizeof(stored)) &&
+                 stored.low == -125 && stored.high == -75;
+    bool written = tempControlCurrentSlot == 2 &&
+                   tempControlSlots[2].low == -125 && tempControlSlots[2].high == -75;
+    bool rejected = tempControlSlots[3].low == untouched.low && tempControlSlots[3].high == untouched.high &&
+                    !settingslog_read(&settings, 3, &stored, sizeof(stored));
+    bool inTime = turnaroundMax <= SIM_TURNAROUND_MS * 1000000ULL;
+    bool ok = exited && WIFEXITED(status) && !WEXITSTATUS(status) && ignored && saved && written && rejected && inTime;
+
+    printf("foreign and broken requests %s\n", ignored ? "ignored" : "ANSWERED");
+    printf("slot 3 written %s, stored %s\n", written ? "yes" : "NO", saved ? "yes" : "NO");
+    printf("slot 4 left as it was after rejected write %s\n", rejected ? "yes" : "NO");
+    printf("%u answers, turnaround avg %.2f ms, max %.2f ms (budget %d ms), bytes lost %u  %s\n",
+           answers, answers ? turnaroundTotal / 1e6 / answers : 0, turnaroundMax / 1e6,
+           SIM_TURNAROUND_MS, host_stats.uartRxLost, ok ? "ok" : "FAILED");
+    return !ok;
+}
@@ -0,0 +1,88 @@
+// Step response of the regulator on simulated plant.
+//
+// Firmware heats vessel (see host_plant.c) from ambient temperature
+// to the default slot (20..30), in linear mode with sensor lag
+// estimate turned off and on (build with -DTempSensor_LAG_FILTER,
+// otherwise it is always off), and in PID mode, which does not use it.
+// Medium temperature, not sensor reading, is scored:
+//   final     -- average over the last 10 minutes
+//   overshoot -- highest temperature above final
+//   settling  -- time after which medium stays within 0.5 C of final
+//
+// usage: regulate [sensor lag [dead time [time constant]]], in seconds
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <host.h>
+#include <Firmware.h>
+
+#define SIM_AMBIENT 15.0f
+#define SIM_DURATION_S 7200
+#define SIM_FINAL_S 600
+#define SIM_SETTLED 0.5f
+
+static HostPlant plant = {SIM_AMBIENT, 40, 300, 5, 30, 0, LOW};
+static float trace[SIM_DURATION_S];
+
+static void run(const char *name, bool pid, uint16_t lag)
+{
+    host_reset();
+    host_ds18b20_attach(tempSensorPin);
+    plant.pin = outputPin;
+    host_plant_attach(&plant, SIM_AMBIENT);
+#ifdef TempSensor_LAG_FILTER
+    tempSensorLag = lag;
+#else
+    if (lag)
+        return;
+#endif
+    setup();
+#ifdef TempControl_PID
+    tempControlPidSlots = pid;
+#else
+    if (pid)
+        return;
+#endif
+
+    for (uint32_t second = 0; second < SIM_DURATION_S; second++)
+    {
+        while (millis() < (second + 1) * 1000)
+            loop();
+        trace[second] = host_plant_temperature();
+    }
+
+    float final = 0;
+    for (uint32_t second = SIM_DURATION_S - SIM_FINAL_S; second < SIM_DURATION_S; second++)
+        final += trace[second];
+    final /= SIM_FINAL_S;
+
+    float overshoot = 0;
+    uint32_t settled = 0;
+    for (uint32_t second = 0; second < SIM_DURATION_S; second++)
+    {
+        float error = trace[second] - final;
+        if (error > overshoot)
+            overshoot = error;
+        if (error > SIM_SETTLED || error < -SIM_SETTLED)
+            settled = second + 1;
+    }
+    printf("%-6s lag estimate %-3s  final %6.2f C  overshoot %5.2f C  settling %5u s\n",
+           name, lag ? "on" : "off", final, overshoot, settled);
+}
+
+int main(int argc, char **argv)
+{
+    if (argc > 1)
+        plant.sensorLag = atof(argv[1]);
+    if (argc > 2)
+        plant.deadTime = atof(argv[2]);
+    if (argc > 3)
+        plant.timeConstant = atof(argv[3]);
+    printf("plant: %.0f C rise, %.0f s time constant, %.0f s dead time, %.0f s sensor lag\n",
+           plant.gain, plant.timeConstant, plant.deadTime, plant.sensorLag);
+
+    run("linear", false, 0);
+    run("linear", false, plant.sensorLag);
+    run("PID", true, 0);
+    return 0;
+}
@@ -0,0 +1,410 @@
+// Replay of a recorded temperature trace through the regulator.
+//
+// Temperature of the trace (CSV: time, temperature in degrees,
+// other columns are ignored; time is in seconds, or in ms if the
+// header names it time_ms, as tools/telemetry.c writes it)
+// is what the sensor reads: this file takes place of nanoDS18B20_C,
+// so readings are rounded and cut to the resolution the firmware
+// sets, and the firmware itself decides when to read them.
+// Trace is interpolated between its samples.
+//
+// Tasks of the firmware scheduler run at their periods, except
+// display refresh and the ones of buttons and menu, which only
+// matter when somebody looks at the device (and menu never opens
+// without buttons). Simulated time jumps from one task to the next,
+// and output steps between them are counted in a batch, so a day
+// of trace takes a fraction of a second.
+//
+// Every slot given runs over the whole trace, and a CSV line is
+// written for it:
+//   on_percent         -- share of time output was on
+//   switches_per_hour  -- times output was turned on
+//   outside_percent    -- share of time reading was out of the slot range
+// Slot is LOW,HIGH[,pid] in degrees, LOW and HIGH can be ranges
+// FROM:TO:STEP, every combination of them is run.
+//
+// usage: replay trace.csv slot...
+// example: replay day.csv 19:21:0.5,29:31:0.5 20,30,pid
+
+#ifdef nanods_ASYNC
+#error "replay reads the sensor in place of synchronous nanoDS18B20_C only"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <host.h>
+#include <Firmware.h>
+#include <nanoDS18B20_C.h>
+
+#define REPLAY_SLOTS_MAX 4096
+#define REPLAY_TICK_NS 200000ULL // ITERATION_DURATION in main.c
+
+typedef struct ReplaySample
+{
+    uint64_t ns; // from the first sample
+    float temperature;
+} ReplaySample;
+
+typedef struct ReplaySlot
+{
+    TempControlSlot slot;
+    bool pid;
+} ReplaySlot;
+
+static ReplaySample *samples;
+static uint32_t samplesCount;
+static uint32_t sampleNum; // last sample at or before now
+
+static ReplaySlot slots[REPLAY_SLOTS_MAX];
+static uint16_t slotsCount;
+
+static uint8_t resolution = 12;
+
+// Sensor of the trace, in place of nanoDS18B20_C
+
+#ifndef nanods_NOPARASITE
+void microds_init(NanoDS18B20 *device, uint8_t dsPin, bool parasitePowered)
+{
+    (void)parasitePowered;
+#else
+void microds_init(NanoDS18B20 *device, uint8_t dsPin)
+{
+#endif
+    device->dsPin = dsPin;
+    device->_buf = 0;
+    device->_tempUpdating = false;
+}
+
+#ifdef nanods_MULTI
+uint8_t microds_search(uint8_t dsPin, uint8_t roms[][8], uint8_t maxCount)
+{
+    (void)dsPin;
+    (void)roms;
+    (void)maxCount;
+    return 1;
+}
+
+void microds_setAddress(NanoDS18B20 *device, const uint8_t *rom)
+{
+    (void)device;
+    (void)rom;
+}
+#endif
+
+#ifndef nanods_NORES
+void microds_setResolution(NanoDS18B20 *device, uint8_t res)
+{
+    (void)device;
+    resolution = constrain(res, 9, 12);
+}
+#endif
+
+bool microds_requestTemp(NanoDS18B20 *device)
+{
+    device->_tempUpdating = true;
+    return true;
+}
+
+// Temperature of the trace now, as DS18B20 reports it
+bool microds_readTemp(NanoDS18B20 *device)
+{
+    while (sampleNum + 1 < samplesCount && samples[sampleNum + 1].ns <= host_ns)
+        sampleNum++;
+    ReplaySample *sample = &samples[sampleNum];
+    float temperature = sample->temperature;
+    if (sampleNum + 1 < samplesCount)
+    {
+        ReplaySample *next = sample + 1;
+        temperature += (next->temperature - sample->temperature) *
+                       (host_ns - sample->ns) / (next->ns - sample->ns);
+    }
+    float raw = temperature * 16;
+    int16_t rounded = (int16_t)(raw < 0 ? raw - 0.5f : raw + 0.5f);
+    device->_buf = rounded & ~((1 << (12 - resolution)) - 1);
+    device->_tempUpdating = false;
+    return true;
+}
+
+int16_t microds_getTemp10(NanoDS18B20 *device)
+{
+    return (device->_buf * 10 + 8) >> 4;
+}
+
+#ifndef nanods_NOFLOAT
+float microds_getTemp(NanoDS18B20 *device)
+{
+    return device->_buf / 16.0f;
+}
+#endif
+
+static bool loadTrace(const char *path)
+{
+    FILE *file = fopen(path, "r");
+    if (!file)
+    {
+        perror(path);
+        return false;
+    }
+
+    uint32_t capacity = 0;
+    double timeScale = 1e9;
+    double start = 0;
+    char line[256];
+    while (fgets(line, sizeof(line), file))
+    {
+        char *end;
+        double time = strtod(line, &end);
+        if (end == line || *end != ',')
+        {
+            // header
+            if (!samplesCount && !strncmp(line, "time_ms", 7))
+                timeScale = 1e6;
+            continue;
+        }
+        char *field = end + 1;
+        double temperature = strtod(field, &end);
+        if (end == field)
+            continue;
+
+        if (samplesCount == capacity)
+        {
+            capacity = capacity ? capacity * 2 : 4096;
+            samples = realloc(samples, capacity * sizeof(ReplaySample));
+        }
+        if (!samplesCount)
+            start = time;
+        // time must not go back, samples of the same time are merged
+        uint64_t ns = (uint64_t)((time - start) * timeScale);
+        if (samplesCount && ns <= samples[samplesCount - 1].ns)
+            samplesCount--;
+        samples[samplesCount].ns = ns;
+        samples[samplesCount].temperature = temperature;
+        samplesCount++;
+    }
+    fclose(file);
+    if (samplesCount < 2)
+    {
+        fprintf(stderr, "%s: not enough samples\n", path);
+        return false;
+    }
+    return true;
+}
+
+// FROM[:TO:STEP] in degrees, to temp*10
+static uint16_t parseRange(const char *text, int16_t *from, int16_t *to, int16_t *step)
+{
+    float values[3] = {0, 0, 1};
+    uint8_t count = 0;
+    char *end;
+    do
+    {
+        values[count++] = strtof(text, &end);
+        if (end == text)
+            return 0;
+        text = end + 1;
+    } while (*end == ':' && count < 3);
+    if (count == 2 || *end)
+        return 0;
+    if (count == 1)
+        values[1] = values[0];
+    *from = (int16_t)(values[0] * 10 + (values[0] < 0 ? -0.5f : 0.5f));
+    *to = (int16_t)(values[1] * 10 + (values[1] < 0 ? -0.5f : 0.5f));
+    *step = (int16_t)(values[2] * 10 + 0.5f);
+    if (*step <= 0 || *to < *from)
+        return 0;
+    return (*to - *from) / *step + 1;
+}
+
+static bool addSlots(const char *arg)
+{
+    char text[64];
+    snprintf(text, sizeof(text), "%s", arg);
+    char *high = strchr(text, ',');
+    if (!high)
+        return false;
+    *high++ = 0;
+    char *mode = strchr(high, ',');
+    bool pid = false;
+    if (mode)
+    {
+        *mode++ = 0;
+        if (strcmp(mode, "pid"))
+            return false;
+        pid = true;
+    }
+
+    int16_t lowFrom, lowTo, lowStep, highFrom, highTo, highStep;
+    uint16_t lows = parseRange(text, &lowFrom, &lowTo, &lowStep);
+    uint16_t highs = parseRange(high, &highFrom, &highTo, &highStep);
+    if (!lows || !highs)
+        return false;
+    for (uint16_t i = 0; i < lows; i++)
+    {
+        for (uint16_t j = 0; j < highs; j++)
+        {
+            if (slotsCount == REPLAY_SLOTS_MAX)
+                return false;
+            ReplaySlot *replaySlot = &slots[slotsCount++];
+            replaySlot->slot.low = lowFrom + i * lowStep;
+            replaySlot->slot.high = highFrom + j * highStep;
+            replaySlot->pid = pid;
+        }
+    }
+    return true;
+}
+
+static bool skipped(SchedulerCallback callback)
+{
+    return callback == task_refreshDisplay || callback == task_input ||
+           callback == task_buttonHold || callback == task_menuDecay;
+}
+
+typedef struct ReplayStats
+{
+    uint64_t steps; // of output
+    uint64_t onSteps;
+    uint32_t switches;
+    bool on; // after the last step counted
+} ReplayStats;
+
+// Steps of x, counted from step 0 of the first cycle, with output on
+static uint64_t onStepsBefore(uint64_t x, uint16_t high)
+{
+    return x / output.period * high + min(x % output.period, high);
+}
+
+// Output steps in a row, while its duty cycle does not change.
+// All of them but the last are only counted (they would do what
+// slowpwm_step does), the last one runs as task of the firmware,
+// so pin and state of SlowPWM stay its own.
+static void outputSteps(uint16_t count, ReplayStats *stats)
+{
+    if (count > 1)
+    {
+        uint16_t high = min(output.high, output.period);
+        uint64_t first = output.step + 1;
+        uint64_t last = output.step + count - 1;
+        stats->onSteps += onStepsBefore(last + 1, high) - onStepsBefore(first, high);
+        stats->switches += first % output.period < high && !stats->on;
+        // turned on at the start of every cycle after the first step
+        if (high && high < output.period)
+            stats->switches += last / output.period - first / output.period;
+        stats->steps += count - 1;
+        stats->on = last % output.period < high;
+        output.step = last % output.period;
+    }
+
+    task_output();
+    stats->switches += output.on && !stats->on;
+    stats->onSteps += output.on;
+    stats->steps++;
+    stats->on = output.on;
+}
+
+static void replay(const ReplaySlot *replaySlot)
+{
+    host_reset();
+    sampleNum = 0;
+    setup();
+    tempControlSlots[tempControlCurrentSlot] = replaySlot->slot;
+#ifdef TempControl_PID
+    tempControlPidSlots = replaySlot->pid ? 1 << tempControlCurrentSlot : 0;
+#endif
+    int16_t bottom = min(replaySlot->slot.low, replaySlot->slot.high);
+    int16_t top = max(replaySlot->slot.low, replaySlot->slot.high);
+
+    SchedulerTask *outputTask = NULL;
+    for (uint8_t taskNum = 0; taskNum < scheduler.numTasks; taskNum++)
+        if (scheduler.tasks[taskNum].callback == task_output)
+            outputTask = &scheduler.tasks[taskNum];
+
+    ReplayStats stats = {0, 0, 0, output.on};
+    uint64_t outsideTicks = 0, ticks = 0;
+    uint64_t end = samples[samplesCount - 1].ns;
+    while (host_ns < end)
+    {
+        // ticks until the next task, other than output
+        uint16_t jump = UINT16_MAX;
+        for (uint8_t taskNum = 0; taskNum < scheduler.numTasks; taskNum++)
+        {
+            SchedulerTask *task = &scheduler.tasks[taskNum];
+            if (task != outputTask && !skipped(task->callback))
+                jump = min(jump, task->countdown);
+        }
+
+        // output steps before it, as scheduler_run would make them
+        if (outputTask && outputTask->countdown < jump)
+        {
+            uint16_t count = (jump - 1 - outputTask->countdown) / outputTask->period + 1;
+            outputSteps(count, &stats);
+            outputTask->countdown += count * outputTask->period;
+        }
+
+        if (tempUpdatePrev < bottom || tempUpdatePrev > top)
+            outsideTicks += jump;
+        ticks += jump;
+        host_advanceNs(jump * REPLAY_TICK_NS);
+
+        // tasks of that tick, in order they were added
+        for (uint8_t taskNum = 0; taskNum < scheduler.numTasks; taskNum++)
+        {
+            SchedulerTask *task = &scheduler.tasks[taskNum];
+            if (skipped(task->callback))
+                continue;
+            if (task->countdown == jump)
+            {
+                if (task == outputTask)
+                    outputSteps(1, &stats);
+                else
+                    task->callback();
+                task->countdown += task->period;
+            }
+            task->countdown -= jump;
+        }
+    }
+
+    printf("%.1f,%.1f,%s,%.2f,%.1f,%.2f\n",
+           replaySlot->slot.low / 10.0, replaySlot->slot.high / 10.0,
+           replaySlot->pid ? "pid" : "linear",
+           stats.steps ? 100.0 * stats.onSteps / stats.steps : 0.0,
+           stats.switches * 3600e9 / end,
+           100.0 * outsideTicks / ticks);
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 3)
+    {
+        fprintf(stderr, "usage: %s trace.csv LOW,HIGH[,pid]...\n", argv[0]);
+        return 2;
+    }
+    if (!loadTrace(argv[1]))
+        return 1;
+    for (int i = 2; i < argc; i++)
+    {
+        if (!addSlots(argv[i]))
+        {
+            fprintf(stderr, "bad slot: %s\n", argv[i]);
+            return 2;
+        }
+#ifndef TempControl_PID
+        if (slots[slotsCount - 1].pid)
+        {
+            fprintf(stderr, "pid slot needs -DTempControl_PID build: %s\n", argv[i]);
+            return 2;
+        }
+#endif
+    }
+
+    printf("low,high,mode,on_percent,switches_per_hour,outside_percent\n");
+    clock_t start = clock();
+    for (uint16_t slotNum = 0; slotNum < slotsCount; slotNum++)
+        replay(&slots[slotNum]);
+    double seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+    double hours = samples[samplesCount - 1].ns / 3600e9;
+    fprintf(stderr, "%u slots over %.1f hours of trace in %.2f s (%.3f s per slot)\n",
+            slotsCount, hours, seconds, seconds / slotsCount);
+    return 0;
+}
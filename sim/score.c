@@ -0,0 +1,194 @@
+// Regression score of the regulator on a fixed suite of plants.
+//
+// Every scenario is a vessel (see host_plant.c) given by heater
+// power, heat capacity and losses to ambient, with dead time
+// and sensor lag. Firmware regulates it from ambient temperature
+// to the middle of the slot, heating (high > low) or cooling
+// (low > high, negative power), in linear mode and in PID mode
+// (build with -DTempControl_PID, otherwise only linear is run).
+// Medium temperature, not sensor reading, is scored:
+//   overshoot -- furthest past final in the direction of approach
+//   settling  -- time after which medium stays within 0.5 C of final
+// (both from the start, or from the step of ambient if there is one)
+//   error     -- final (average over the last 10 minutes) minus setpoint
+//   starts    -- times output was started from zero duty cycle, per hour
+//                (SlowPWM turns it on every cycle, those are not counted)
+//   energy    -- heater (or cooler) energy, Wh
+// and cost of the run is a weighted sum of the first three
+// and starts (see SCORE_*), lower is better.
+//
+// usage: score [baseline]
+// exit status is non-zero if a run has not settled,
+// or if total cost is over baseline (total of a previous run)
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <host.h>
+#include <Firmware.h>
+
+#define SIM_FINAL_S 600
+#define SIM_SETTLED 0.5f
+#define SIM_DURATION_MAX_S 14400
+
+// cost of 1 C of overshoot or error, of a minute of settling
+// and of 10 starts per hour
+#define SCORE_OVERSHOOT 10.0f
+#define SCORE_ERROR 10.0f
+#define SCORE_SETTLING 0.1f
+#define SCORE_STARTS 1.0f
+
+typedef struct SimScenario
+{
+    const char *name;
+    float ambient;
+    float power;    // W, negative for cooler
+    float capacity; // J/K
+    float loss;     // W/K
+    float deadTime;
+    float sensorLag;
+    int16_t low; // slot, temp*10
+    int16_t high;
+    uint32_t duration; // s
+    uint32_t stepAt;   // s, ambient steps to stepAmbient then, 0 for never
+    float stepAmbient;
+} SimScenario;
+
+static const SimScenario scenarios[] = {
+    // litre of water on 100 W
+    {"water", 15, 100, 4200, 2.5f, 5, 20, 200, 300, 10800, 0, 0},
+    // small block with slow sensor
+    {"block", 20, 50, 500, 1, 5, 30, 350, 450, 7200, 0, 0},
+    // oven with long dead time
+    {"oven", 20, 1000, 20000, 10, 60, 10, 550, 650, 10800, 0, 0},
+    // fridge, cooling mode
+    {"fridge", 30, -60, 4200, 3, 10, 20, 140, 100, 10800, 0, 0},
+    // water again, room cools down in the middle
+    {"draught", 15, 100, 4200, 2.5f, 5, 20, 200, 300, 14400, 7200, 5},
+};
+
+#define SCENARIOS_COUNT (sizeof(scenarios) / sizeof(scenarios[0]))
+
+typedef struct SimScore
+{
+    float overshoot;
+    uint32_t settling;
+    float error;
+    float starts;
+    float energy;
+    float cost;
+} SimScore;
+
+static float trace[SIM_DURATION_MAX_S];
+
+static SimScore run(const SimScenario *scenario, bool pid)
+{
+    HostPlant plant = {
+        scenario->ambient,
+        scenario->power / scenario->loss,
+        scenario->capacity / scenario->loss,
+        scenario->deadTime,
+        scenario->sensorLag,
+        outputPin,
+        LOW,
+    };
+    host_reset();
+    host_ds18b20_attach(tempSensorPin);
+    host_plant_attach(&plant, scenario->ambient);
+    setup();
+    TempControlSlot slot = {scenario->low, scenario->high};
+    tempControlSlots[tempControlCurrentSlot] = slot;
+#ifdef TempControl_PID
+    tempControlPidSlots = pid ? 1 << tempControlCurrentSlot : 0;
+#else
+    (void)pid;
+#endif
+
+    uint32_t starts = 0;
+    bool off = true;
+    for (uint32_t second = 0; second < scenario->duration; second++)
+    {
+        if (scenario->stepAt && second == scenario->stepAt)
+            host_plant_setAmbient(scenario->stepAmbient);
+        while (millis() < (second + 1) * 1000)
+        {
+            loop();
+            if (off && output.high)
+                starts++;
+            off = !output.high;
+        }
+        trace[second] = host_plant_temperature();
+    }
+
+    SimScore score = {0, 0, 0, 0, 0, 0};
+    float setpoint = (scenario->low + (scenario->high - scenario->low) / 2) / 10.0f;
+    float direction = scenario->high < scenario->low ? -1 : 1;
+
+    float final = 0;
+    for (uint32_t second = scenario->duration - SIM_FINAL_S; second < scenario->duration; second++)
+        final += trace[second];
+    final /= SIM_FINAL_S;
+    score.error = final - setpoint;
+
+    for (uint32_t second = scenario->stepAt; second < scenario->duration; second++)
+    {
+        float error = trace[second] - final;
+        if (error * direction > score.overshoot)
+            score.overshoot = error * direction;
+        if (error > SIM_SETTLED || error < -SIM_SETTLED)
+            score.settling = second + 1 - scenario->stepAt;
+    }
+
+    float hours = scenario->duration / 3600.0f;
+    float power = scenario->power < 0 ? -scenario->power : scenario->power;
+    score.starts = starts / hours;
+    score.energy = host_stats.plantOnNs / 1e9f * power / 3600;
+    score.cost = score.overshoot * SCORE_OVERSHOOT +
+                 (score.error < 0 ? -score.error : score.error) * SCORE_ERROR +
+                 score.settling / 60.0f * SCORE_SETTLING +
+                 score.starts / 10 * SCORE_STARTS;
+    return score;
+}
+
+int main(int argc, char **argv)
+{
+    float baseline = argc > 1 ? atof(argv[1]) : 0;
+
+    printf("%-8s %-6s %10s %10s %10s %10s %10s %8s\n",
+           "plant", "mode", "overshoot", "settling", "error", "starts/h", "energy", "cost");
+
+    bool settled = true;
+    float total = 0;
+    uint32_t simulated = 0;
+    clock_t start = clock();
+    for (uint8_t i = 0; i < SCENARIOS_COUNT; i++)
+    {
+        for (uint8_t pid = 0; pid < 2; pid++)
+        {
+#ifndef TempControl_PID
+            if (pid)
+                continue;
+#endif
+            const SimScenario *scenario = &scenarios[i];
+            SimScore score = run(scenario, pid);
+            printf("%-8s %-6s %8.2f C %8u s %8.2f C %10.1f %7.1f Wh %8.2f\n",
+                   scenario->name, pid ? "PID" : "linear",
+                   score.overshoot, score.settling, score.error,
+                   score.starts, score.energy, score.cost);
+            if (scenario->stepAt + score.settling > scenario->duration - SIM_FINAL_S)
+                settled = false;
+            total += score.cost;
+            simulated += scenario->duration;
+        }
+    }
+
+    double seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+    printf("\n%.1f simulated hours in %.1f s (%.0fx real time)\n",
+           simulated / 3600.0, seconds, simulated / seconds);
+    bool ok = settled && (!baseline || total <= baseline);
+    printf("total cost %.2f", total);
+    if (baseline)
+        printf(" (baseline %.2f)", baseline);
+    printf("%s  %s\n", settled ? "" : ", not settled", ok ? "ok" : "FAILED");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,141 @@
+// Telemetry through a pty, as if it came from USB-serial adapter.
+//
+// Firmware heats simulated vessel (see host_plant.c), bytes it sends
+// over UART are written to a pty, and decoder (tools/telemetry.c)
+// reads the other side of it into CSV. Decoder joins the stream
+// in the middle of a frame, and one frame is damaged on the way,
+// both must be skipped and every other frame must come unchanged.
+// Line load is reported against its 9600 baud capacity.
+//
+// usage: telemetry [decoder [seconds]], seconds are simulated, 300 by default,
+// decoder is the one built by native_teledecode environment by default.
+// CSV is kept in file named by TELEMETRY_CSV environment variable, if it is set.
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <host.h>
+#include <Firmware.h>
+#include <Telemetry.h>
+// after host.h, it defines CR1 and others as macros
+#include <fcntl.h>
+#include <termios.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/wait.h>
+
+#define SIM_AMBIENT 15.0f
+#define SIM_BAUD 9600
+#define SIM_SKIP_BYTES 7      // decoder starts in the middle of the first frame
+#define SIM_DAMAGED_FRAME 10  // and this one has a bit flipped
+#define SIM_MAX_FRAMES 100000
+#define SIM_DECODER ".pio/build/native_teledecode/program"
+
+static HostPlant plant = {SIM_AMBIENT, 40, 300, 5, 30, 0, LOW};
+
+static int master;
+static uint8_t *stream;
+static uint32_t streamSize;
+
+static void sendByte(uint8_t byte)
+{
+    if (streamSize < SIM_MAX_FRAMES * TELEMETRY_FRAME_SIZE)
+        stream[streamSize] = byte;
+    streamSize++;
+    if (streamSize <= SIM_SKIP_BYTES)
+        return;
+    if (streamSize == SIM_DAMAGED_FRAME * TELEMETRY_FRAME_SIZE + 6)
+        byte ^= 0x10;
+    if (write(master, &byte, 1) != 1)
+        perror("pty");
+}
+
+int main(int argc, char **argv)
+{
+    const char *decoderPath = argc > 1 ? argv[1] : SIM_DECODER;
+    uint32_t seconds = argc > 2 ? strtoul(argv[2], NULL, 10) : 300;
+    stream = malloc(SIM_MAX_FRAMES * TELEMETRY_FRAME_SIZE);
+
+    master = posix_openpt(O_RDWR | O_NOCTTY);
+    if (master < 0 || grantpt(master) || unlockpt(master))
+    {
+        perror("pty");
+        return 1;
+    }
+    // raw before decoder starts, bytes written meanwhile are not mangled
+    const char *slaveName = ptsname(master);
+    int slave = open(slaveName, O_RDWR | O_NOCTTY);
+    struct termios tio;
+    tcgetattr(slave, &tio);
+    cfmakeraw(&tio);
+    tcsetattr(slave, TCSANOW, &tio);
+
+    char csvName[] = "/tmp/telemetryXXXXXX";
+    int csv = mkstemp(csvName);
+    pid_t decoder = fork();
+    if (!decoder)
+    {
+        // decoder must not keep master open, it would never see the end
+        dup2(csv, STDOUT_FILENO);
+        close(csv);
+        close(master);
+        close(slave);
+        execl(decoderPath, decoderPath, slaveName, NULL);
+        perror(decoderPath);
+        _exit(1);
+    }
+
+    host_reset();
+    host_ds18b20_attach(tempSensorPin);
+    plant.pin = outputPin;
+    host_plant_attach(&plant, SIM_AMBIENT);
+    setup();
+    host_onUartTx = sendByte;
+    while (millis() < seconds * 1000)
+        loop();
+    host_onUartTx = NULL;
+
+    // let decoder take everything, pty drops it on close
+    int waiting;
+    while (!ioctl(slave, FIONREAD, &waiting) && waiting)
+        usleep(10000);
+    usleep(100000);
+    close(master);
+    close(slave);
+    int status;
+    waitpid(decoder, &status, 0);
+
+    // every whole frame sent, but the first and the damaged one
+    uint32_t sent = min(streamSize, SIM_MAX_FRAMES * TELEMETRY_FRAME_SIZE) / TELEMETRY_FRAME_SIZE;
+    uint32_t expected = 1, received = 0, wrong = 0;
+    FILE *rows = fopen(csvName, "r");
+    char line[128];
+    fgets(line, sizeof(line), rows); // header
+    while (fgets(line, sizeof(line), rows))
+    {
+        if (expected == SIM_DAMAGED_FRAME)
+            expected++;
+        TelemetryFrame frame;
+        unsigned time, duty;
+        double temperature;
+        if (expected >= sent ||
+            !telemetry_decode(stream + expected * TELEMETRY_FRAME_SIZE, &frame) ||
+            sscanf(line, "%u,%lf,%*f,%*f,%u", &time, &temperature, &duty) != 3 ||
+            time != frame.time || temperature != frame.raw / 16.0 || duty != frame.duty)
+            wrong++;
+        expected++;
+        received++;
+    }
+    fclose(rows);
+    if (getenv("TELEMETRY_CSV"))
+        rename(csvName, getenv("TELEMETRY_CSV"));
+    else
+        unlink(csvName);
+
+    bool ok = WIFEXITED(status) && !WEXITSTATUS(status) && !wrong && received == sent - 2;
+    printf("%u s: %u frames sent (%.1f per second), %u decoded, %u wrong\n",
+           seconds, sent, (double)sent / seconds, received, wrong);
+    printf("line load at %d baud: %.1f %%  %s\n",
+           SIM_BAUD, 100.0 * streamSize * 10 / SIM_BAUD / seconds, ok ? "ok" : "FAILED");
+    return !ok;
+}
@@ -1,16 +1,44 @@
+#include <Firmware.h>
 #include <EEPROM.h>
 #include <Arduino.h>
 #include <SevSegC.h>
 #include <nanoDS18B20_C.h>
-
-typedef struct Button
-{
-  uint8_t pin;
-  uint8_t timer;
-  uint8_t counter;
-
-  bool changed; // set by readButton, unset by handleButtonClick
-} Button;
+#include <Scheduler.h>
+#include <SettingsLog.h>
+#ifdef TempControl_PID
+#include <PID.h>
+#endif
+#ifdef TempControl_AUTOTUNE
+#include <RelayTune.h>
+#endif
+#include <SlowPWM.h>
+#ifdef Button_INTERRUPT
+#include <Buttons.h>
+#endif
+#ifdef TempSensor_LAG_FILTER
+#include <LagFilter.h>
+#endif
+#if defined(SEVSEG_TIMER) || defined(Output_TIMER) || defined(SCHEDULER_TIMER)
+#include <TimerTick.h>
+#endif
+#ifdef Telemetry_UART
+#include <Uart.h>
+#include <Telemetry.h>
+#endif
+#ifdef Modbus_RTU
+#include <Modbus.h>
+#endif
+#if defined(Telemetry_UART) && defined(Modbus_RTU)
+#error "Telemetry_UART and Modbus_RTU both need UART1"
+#endif
+#if defined(SCHEDULER_PROFILE) && defined(nanods_ASYNC)
+#error "SCHEDULER_PROFILE and nanods_ASYNC both need TIM1"
+#endif
+// digit moved to PB4 shares port with output on PB5,
+// so both or neither of them may be written from TIM2 interrupt
+#if (defined(Telemetry_UART) || defined(Modbus_RTU)) && (defined(SEVSEG_TIMER) != defined(Output_TIMER))
+#error "UART puts a digit next to output, use SEVSEG_TIMER and Output_TIMER together or neither"
+#endif
 
 typedef struct ButtonClick
 {
@@ -19,26 +47,69 @@ typedef struct ButtonClick
   bool pressed;
 } ButtonClick;
 
-typedef struct TempControlSlot
-{
-  int16_t low;
-  int16_t high;
-} TempControlSlot;
+// with nanods_MULTI every sensor found on the pin
+// is read after one conversion, and their average is used
+#ifdef nanods_MULTI
+#define TempSensor_MAX 4
+uint8_t tempSensorRoms[TempSensor_MAX][8];
+#else
+#define TempSensor_MAX 1
+#endif
 
 SevSeg display;
-NanoDS18B20 tempSensor;
+NanoDS18B20 tempSensors[TempSensor_MAX];
+uint8_t tempSensorsCount;
 
 uint8_t outputPin = 3;
 uint8_t buttonUpPin = 1;
 uint8_t buttonDownPin = 0;
 uint8_t tempSensorPin = 2;
+#if defined(Telemetry_UART) || defined(Modbus_RTU)
+// UART TX is on pin 14 (PD5), so the digit is moved to pin 4
+// (PB4, open drain, needs pull-up when digits are active high)
+uint8_t digitPins[3] = {15, 4, 13};
+#else
 uint8_t digitPins[3] = {15, 14, 13};
+#endif
 uint8_t segmentPins[8] = {11, 12, 8, 6, 5, 10, 9, 7};
 
 #define TempUpdate_READY 0
-#define TempUpdate_TIMEOUT 10 // specified in iterations
-uint8_t tempUpdateStep;
-float tempUpdatePrev;
+#define TempUpdate_TIMEOUT 40 // ticks of task_temperature, after conversion
+uint8_t tempUpdateStep; // ticks since conversion was requested
+uint8_t tempUpdateWait; // ticks conversion takes
+int16_t tempUpdatePrev; // temp*10
+
+// Conversion takes 94 ms at 9 bit resolution, and twice more
+// for every next bit, up to 750 ms at 12 bits.
+// Without nanods_NORES resolution follows distance from the slot
+// range in linear mode: fast and coarse far from it, fine near it.
+// PID mode keeps 12 bits, its gains assume steady update rate.
+#define TempSensor_RES_MIN 9
+#define TempSensor_RES_MAX 12
+#define TempSensor_CONVERSION_MAX 750 // ms, at 12 bits
+#define TempSensor_NEAR 10            // 11 bits within 1 degree of the range
+#define TempSensor_FAR 30             // 10 bits within 3 degrees, 9 beyond
+#ifndef nanods_NORES
+uint8_t tempSensorResolution; // set on sensors, 0 before it is set
+uint8_t tempSensorNextResolution;
+#endif
+
+// With TempSensor_LAG_FILTER defined, linear output is controlled
+// by estimate of medium temperature, which sensor in its sheath lags
+// behind (see LagFilter.h). PID and relay test get sensor reading,
+// the estimate made PID settle slower. Display shows the reading.
+// tempSensorLag is time constant of the sensor in seconds,
+// zero turns estimate off.
+#ifdef TempSensor_LAG_FILTER
+uint16_t tempSensorLag = 30;
+LagFilter tempSensorFilter;
+uint32_t tempUpdateTime; // millis of the previous reading
+#endif
+#ifdef nanods_ASYNC
+uint8_t tempReadSensor; // sensor being read in background
+uint8_t tempReadCount;
+int16_t tempReadSum;
+#endif
 
 // temperature defined as temp*10
 #define TempControl_ONCE_STEP 1
@@ -48,14 +119,55 @@ float tempUpdatePrev;
 #define TempControl_MIN_TEMP -400
 #define TempControl_DEFAULT_HIGH 300
 #define TempControl_DEFAULT_LOW 200
+// Settings were stored at fixed addresses before, they are still read
+// from there until settings log has newer values
 #define TempControl_EEPROM_CURRENT_SLOT_ADDR 0
 #define TempControl_EEPROM_SLOTS_ADDR 10
+#define TempControl_EEPROM_LOG_ADDR 40
+#define TempControl_EEPROM_LOG_SIZE 600
+// keys of settings log, slots use their index
+#define TempControl_KEY_CURRENT_SLOT TempControl_SLOTS_COUNT
+#define TempControl_KEY_PID_SLOTS (TempControl_SLOTS_COUNT + 1)
+#define TempControl_KEY_TUNINGS (TempControl_SLOTS_COUNT + 2) // and one more for every slot
+SettingsLog settings;
 uint8_t tempControlCurrentSlot;
 TempControlSlot tempControlSlots[TempControl_SLOTS_COUNT];
 
+// With TempControl_PID defined, each slot can be switched to PID mode:
+// temperature is held in the middle between HIGH and LOW,
+// and the range between them sets proportional gain,
+// the same as the slope of linear mode.
+// Integral and derivative times are in temperature updates (~850 ms).
+#ifdef TempControl_PID
+#define TempControl_PID_INTEGRAL_TIME 700 // 10 minutes
+#define TempControl_PID_DERIVATIVE_TIME 12 // 10 seconds
+uint8_t tempControlPidSlots; // bit for every slot in PID mode
+bool tempControlPidSwitched; // both buttons were released since the switch
+PID pid;
+#endif
+
+// With TempControl_AUTOTUNE defined, PID slot has one more mode
+// (shown as "-2"): when menu is closed on it, relay test is run.
+// Output is switched fully on below the middle of the range
+// and off above it, and from the oscillation ultimate gain and period
+// are found and stored for the slot. PID of the slot uses gains
+// computed from them, instead of the range derived ones.
+#ifdef TempControl_AUTOTUNE
+#define TempControl_AUTOTUNE_HYSTERESIS 2
+typedef struct TempControlTuning
+{
+  int16_t ultimateGain;
+  uint16_t ultimatePeriod; // in temperature updates
+} TempControlTuning;
+bool tempControlTunePending; // relay test is run when menu is closed
+RelayTune tune;
+#endif
+
 // THRESHOLD is how much iterations button pin should be
 // high to be considered pressed. Higher values
 // cause higher input lag, but better
+// With Button_INTERRUPT defined, buttons are not polled:
+// pin edges interrupt, and debounced events are queued (see Buttons.h)
 #define Button_DELTA 5
 #define Button_THRESHOLD 15
 Button buttonUp;
@@ -64,40 +176,131 @@ Button buttonDown;
 #define OutputLevel_ON LOW // assume PNP transistor on output pin
 #define OutputLevel_OFF HIGH
 #define OutputDutyCycle_DURATION 10000 // in iterations
-// This was not implemented cause lack of flash memory
-// #define OutputDutyCycle_MAX 1
-// #define OutputDutyCycle_MIN 0
-float outputHighCycleDuration;
-
-#define MenuState_DEFAULT 0
-#define MenuState_SHOW_TEMP 1
-#define MenuState_SET_LOW 11
-#define MenuState_SET_HIGH 12
-#define MenuState_SET_SLOT 20
+#define OutputDutyCycle_STEPS (OutputDutyCycle_DURATION / Task_OUTPUT_PERIOD)
+#define OutputDutyCycle_MAX OutputDutyCycle_STEPS
+#define OutputDutyCycle_MIN 0
+SlowPWM output;
+
+// menu states are in Firmware.h
 #define MenuActive_MAX 120
 #define MenuTempSet_FLASH_START 75
 #define MenuTempSet_FLASH_DELAY 15
 uint8_t menuState;
 uint8_t menuActiveCounter;
 
+// Periods of tasks are counted in iterations,
+// which are ticks of the scheduler.
+// With SEVSEG_TIMER or Output_TIMER defined, TIM2 ticks
+// at the same rate, and display refresh or output
+// run from its interrupt instead of the scheduler.
+// With SCHEDULER_TIMER defined, iterations start on the same tick,
+// and the core sleeps between them
 #define ITERATION_DURATION 200
-uint32_t currentIteration;
-uint64_t prevIterationStart;
-
-float numberOnDisplay;
+#define Task_STARTUP_DELAY 1000 // only slot number is displayed meanwhile
+#define Task_DISPLAY_PERIOD 5
+#define Task_BUTTON_HOLD_PERIOD 10
+#define Task_MENU_DECAY_PERIOD 100
+#define Task_TEMPERATURE_PERIOD 250 // every 50ms
+#define Task_TEMPERATURE_MS (Task_TEMPERATURE_PERIOD / (1000 / ITERATION_DURATION))
+#define Task_OUTPUT_PERIOD 10
+Scheduler scheduler;
+
+// With SCHEDULER_PROFILE defined, scheduler counts time of every task
+// and of busy part of every iteration (see Profile.h), and
+// the longest OneWire transaction is counted too. In slot menu
+// UP on the last slot opens hidden profile menu instead of going
+// to the first slot. UP and DOWN switch its pages, number of page
+// is shown as "-N" first, then its value:
+//   -1  iterations missed (overruns of the scheduler)
+//   -2  longest iteration
+//   -3  longest OneWire transaction
+//   -4  longest run of the first task, and so on for every task
+//       in order they are added in setup()
+// Times are in us, or in ms with decimal place from 1 ms on.
+// DOWN on the first page goes back to the last slot.
+#ifdef SCHEDULER_PROFILE
+#define MenuProfile_LABEL_TIME 25 // in menu decay steps
+uint8_t menuProfilePage;
+ProfileCounter profileOneWire;
+uint16_t profileOneWireStart;
+#define profileOneWire_begin() (profileOneWireStart = profile_now())
+#define profileOneWire_end() profile_add(&profileOneWire, profile_now() - profileOneWireStart)
+#else
+#define profileOneWire_begin()
+#define profileOneWire_end()
+#endif
+
+// With Telemetry_UART defined, state of the regulator is sent
+// every Task_TELEMETRY_PERIOD as binary frame (see Telemetry.h).
+// Frame is queued for interrupt driven UART, and skipped
+// if the previous one is still in the queue.
+#ifdef Telemetry_UART
+#define Telemetry_BAUD 9600
+#define Task_TELEMETRY_PERIOD 500 // every 100ms
+#endif
+
+// With Modbus_RTU defined, regulator is Modbus RTU slave (see Modbus.h)
+// on single wire half duplex UART (pin 14, PD5). Holding registers:
+//   0      current slot, from 0
+//   1 + 2n low of slot n, temp*10
+//   2 + 2n high of slot n
+// input registers:
+//   0      temperature, temp*10
+//   1      duty cycle, steps of OutputDutyCycle_STEPS
+//   2      output, 1 when on
+//   16 + n page n + 1 of profile menu, with SCHEDULER_PROFILE
+// Written values are checked as menu checks them, request with
+// any invalid value writes nothing. They are stored
+// after the answer is queued. Any write stops relay test,
+// as any button does.
+#ifdef Modbus_RTU
+#define Modbus_ADDRESS 1
+#define Modbus_BAUD 9600
+#define Modbus_UNSAVED_CURRENT_SLOT 0x80
+#define Modbus_PROFILE_ADDR 16
+uint8_t modbusUnsaved; // bit for every slot written, and for current slot
+#endif
+
+int16_t numberOnDisplay; // temp*10 or integer, same as passed to displayNumber
+bool numberOnDisplayInteger;
 
 void initSlots();
+uint8_t conversionTicks(uint8_t resolution);
 TempControlSlot *currentTempSlot();
-void displayNumber(float value, bool integer);
+#ifdef Modbus_RTU
+uint8_t modbusRead(uint8_t function, uint16_t address, uint16_t *value);
+uint8_t modbusWrite(uint16_t address, uint16_t value, bool apply);
+#endif
 
 void setup()
 {
   tempUpdatePrev = 0;
   tempUpdateStep = TempUpdate_READY;
+  tempUpdateWait = conversionTicks(TempSensor_RES_MAX);
+#ifndef nanods_NORES
+  tempSensorResolution = 0;
+  tempSensorNextResolution = TempSensor_RES_MAX;
+#endif
+#ifdef TempSensor_LAG_FILTER
+  lagfilter_begin(&tempSensorFilter, tempSensorLag);
+#endif
 
   EEPROM_get(TempControl_EEPROM_CURRENT_SLOT_ADDR, tempControlCurrentSlot);
   EEPROM_get(TempControl_EEPROM_SLOTS_ADDR, tempControlSlots);
 
+  settingslog_begin(&settings, TempControl_EEPROM_LOG_ADDR, TempControl_EEPROM_LOG_SIZE);
+  settingslog_read(&settings, TempControl_KEY_CURRENT_SLOT, &tempControlCurrentSlot, sizeof(tempControlCurrentSlot));
+  for (uint8_t slotNum = 0; slotNum < TempControl_SLOTS_COUNT; slotNum++)
+    settingslog_read(&settings, slotNum, &tempControlSlots[slotNum], sizeof(TempControlSlot));
+#ifdef TempControl_PID
+  tempControlPidSlots = 0;
+  settingslog_read(&settings, TempControl_KEY_PID_SLOTS, &tempControlPidSlots, sizeof(tempControlPidSlots));
+  pid_begin(&pid, OutputDutyCycle_MIN, OutputDutyCycle_MAX);
+#endif
+#ifdef TempControl_AUTOTUNE
+  tempControlTunePending = false;
+#endif
+
   if (tempControlCurrentSlot >= TempControl_SLOTS_COUNT)
     tempControlCurrentSlot = 0;
 
@@ -113,28 +316,89 @@ void setup()
   buttonDown.timer = 0;
   buttonDown.counter = 0;
   buttonDown.changed = false;
+#ifdef Button_INTERRUPT
+  buttonUp.pressed = buttonUp.held = buttonUp.clicked = false;
+  buttonDown.pressed = buttonDown.held = buttonDown.clicked = false;
+#endif
 
   menuState = MenuState_DEFAULT;
   menuActiveCounter = 0;
 
-  outputHighCycleDuration = 0;
-
-  currentIteration = 1;
-
+  // level is set before pin becomes output, so load is never on at startup
+  slowpwm_begin(&output, outputPin, OutputLevel_ON, OutputDutyCycle_STEPS);
   pinMode(outputPin, OUTPUT_OD);
-  digitalWrite(outputPin, OutputLevel_OFF);
 
+#ifdef Button_INTERRUPT
+  uint8_t buttonPins[2] = {buttonUpPin, buttonDownPin};
+  buttons_begin(buttonPins, 2);
+#else
   pinMode(buttonUpPin, INPUT_PULLUP);
   pinMode(buttonDownPin, INPUT_PULLUP);
+#endif
 
   sevseg_begin(
       &display,
       3,
       digitPins,
       segmentPins);
-  microds_init(&tempSensor, tempSensorPin);
+#if defined(SEVSEG_TIMER) || defined(Output_TIMER) || defined(SCHEDULER_TIMER)
+  timertick_begin(ITERATION_DURATION);
+#endif
+#ifdef SEVSEG_TIMER
+  sevseg_beginTimer(&display);
+#endif
+#ifdef Output_TIMER
+  timertick_attach(task_output, Task_OUTPUT_PERIOD);
+#endif
+#ifdef nanods_CALIBRATE
+  // before TIM1 is taken by profile_begin
+  oneWire_calibrate(tempSensorPin);
+#endif
+  for (uint8_t sensorNum = 0; sensorNum < TempSensor_MAX; sensorNum++)
+    microds_init(&tempSensors[sensorNum], tempSensorPin);
+  tempSensorsCount = 1;
+#ifdef nanods_MULTI
+  // single sensor is addressed with SKIP ROM, so it may be replaced
+  uint8_t sensorsFound = microds_search(tempSensorPin, tempSensorRoms, TempSensor_MAX);
+  if (sensorsFound > 1)
+  {
+    tempSensorsCount = sensorsFound;
+    for (uint8_t sensorNum = 0; sensorNum < sensorsFound; sensorNum++)
+      microds_setAddress(&tempSensors[sensorNum], tempSensorRoms[sensorNum]);
+  }
+#endif
 
   displayNumber(tempControlCurrentSlot + 1, true);
+
+#ifdef SCHEDULER_PROFILE
+  profile_begin();
+  profile_reset(&profileOneWire);
+#endif
+  scheduler_begin(&scheduler, ITERATION_DURATION);
+#ifdef SCHEDULER_TIMER
+  scheduler_beginTimer(&scheduler);
+#endif
+#ifndef SEVSEG_TIMER
+  scheduler_add(&scheduler, task_refreshDisplay, Task_DISPLAY_PERIOD, 0);
+#endif
+  scheduler_add(&scheduler, task_input, 1, Task_STARTUP_DELAY);
+  scheduler_add(&scheduler, task_temperature, Task_TEMPERATURE_PERIOD, Task_STARTUP_DELAY);
+#ifndef Button_INTERRUPT
+  scheduler_add(&scheduler, task_buttonHold, Task_BUTTON_HOLD_PERIOD, Task_STARTUP_DELAY);
+#endif
+  scheduler_add(&scheduler, task_menuDecay, Task_MENU_DECAY_PERIOD, Task_STARTUP_DELAY);
+#ifndef Output_TIMER
+  scheduler_add(&scheduler, task_output, Task_OUTPUT_PERIOD, Task_STARTUP_DELAY);
+#endif
+#ifdef Telemetry_UART
+  uart_begin(Telemetry_BAUD);
+  scheduler_add(&scheduler, task_telemetry, Task_TELEMETRY_PERIOD, Task_STARTUP_DELAY);
+#endif
+#ifdef Modbus_RTU
+  // after TIM2 tick is started, if it is
+  modbus_begin(Modbus_ADDRESS, Modbus_BAUD, modbusRead, modbusWrite);
+  scheduler_add(&scheduler, task_modbus, 1, Task_STARTUP_DELAY);
+#endif
 }
 
 // if all slots is zero, set them to default
@@ -156,11 +420,6 @@ void initSlots()
   }
 }
 
-bool isNthIteration(uint32_t n)
-{
-  return (currentIteration % n == 0);
-}
-
 TempControlSlot *currentTempSlot()
 {
   TempControlSlot *slot = &tempControlSlots[tempControlCurrentSlot];
@@ -175,19 +434,26 @@ TempControlSlot *currentTempSlot()
   return slot;
 }
 
-void displayNumber(float value, bool integer)
+// value is temp*10, if integer is false
+void displayNumber(int16_t value, bool integer)
 {
-  if (value == numberOnDisplay)
+  if (value == numberOnDisplay && integer == numberOnDisplayInteger)
     return;
 
   numberOnDisplay = value;
-  if (value > -9.9 && !integer)
+  numberOnDisplayInteger = integer;
+  if (integer)
   {
-    sevseg_setNumberF(&display, value, 1);
+    sevseg_setNumber16(&display, value, -1);
+  }
+  else if (value > -99)
+  {
+    sevseg_setNumber16(&display, value, 1);
   }
   else
   {
-    sevseg_setNumber(&display, (int32_t)value, -1);
+    // no space for decimal place
+    sevseg_setNumber16(&display, value / 10, -1);
   }
 }
 
@@ -199,7 +465,7 @@ void displayBlank()
   sevseg_blank(&display);
 }
 
-void displayFlashingNumber(float value, bool integer)
+void displayFlashingNumber(int16_t value, bool integer)
 {
   if (
       menuActiveCounter <= (MenuTempSet_FLASH_START) &&
@@ -218,43 +484,314 @@ void displayTemperature()
   displayNumber(tempUpdatePrev, false);
 }
 
+#ifdef TempControl_PID
+// Duty cycle of PID mode, gains follow the slot range,
+// unless relay test was run for the slot
+uint16_t pidDutyCycle(TempControlSlot *slot, int16_t temp)
+{
+  int16_t range = slot->high - slot->low;
+  int16_t setpoint = slot->low + range / 2;
+  // in cooling mode controller sees temperatures negated
+  if (range < 0)
+  {
+    range = -range;
+    setpoint = -setpoint;
+    temp = -temp;
+  }
+
+#ifdef TempControl_AUTOTUNE
+  TempControlTuning tuning;
+  if (settingslog_read(&settings, TempControl_KEY_TUNINGS + tempControlCurrentSlot, &tuning, sizeof(tuning)))
+    pid_setUltimate(&pid, tuning.ultimateGain, tuning.ultimatePeriod);
+  else
+#endif
+  {
+    int32_t kp = ((int32_t)OutputDutyCycle_STEPS << PID_KP_SHIFT) / max(range, 1);
+    kp = min(kp, INT16_MAX);
+    int32_t ki = (kp << (PID_KI_SHIFT - PID_KP_SHIFT)) / TempControl_PID_INTEGRAL_TIME;
+    int32_t kd = (kp * TempControl_PID_DERIVATIVE_TIME) >> (PID_KP_SHIFT - PID_KD_SHIFT);
+    pid_setGains(&pid, kp, ki, min(kd, INT16_MAX));
+  }
+  return pid_update(&pid, setpoint, temp);
+}
+#endif
+
+#ifdef TempControl_AUTOTUNE
+void startAutotune()
+{
+  TempControlSlot *slot = currentTempSlot();
+  int16_t setpoint = slot->low + (slot->high - slot->low) / 2;
+  // in cooling mode relay sees temperatures negated, same as PID
+  if (slot->high < slot->low)
+    setpoint = -setpoint;
+  relaytune_begin(&tune, setpoint, TempControl_AUTOTUNE_HYSTERESIS, OutputDutyCycle_MAX);
+  menuState = MenuState_AUTOTUNE;
+}
+
+// Duty cycle of relay test, result is stored when it is over
+uint16_t autotuneDutyCycle(TempControlSlot *slot, int16_t temp)
+{
+  uint16_t dutyCycle = relaytune_update(&tune, slot->high < slot->low ? -temp : temp);
+  if (tune.state == RELAYTUNE_RUNNING)
+    return dutyCycle;
+
+  // on failure slot keeps gains it had
+  if (tune.state == RELAYTUNE_DONE)
+  {
+    TempControlTuning tuning = {tune.ultimateGain, tune.ultimatePeriod};
+    settingslog_write(&settings, TempControl_KEY_TUNINGS + tempControlCurrentSlot, &tuning, sizeof(tuning));
+  }
+  menuState = MenuState_DEFAULT;
+  pid_reset(&pid);
+  return pidDutyCycle(slot, temp);
+}
+#endif
+
+// Duty cycle of linear mode
+uint16_t linearDutyCycle(TempControlSlot *slot, int16_t temp)
+{
+  // if range is zero or greater,
+  // output will be turned OFF when temp rises (heating mode)
+  // if range is less than zero,
+  // output will be turned ON when temp rises (cooling mode)
+  //
+  // duty cycle is 1 + (low - temp) / range, which is (high - temp) / range
+  int16_t range = slot->high - slot->low;
+  if (range == 0)
+    return (temp < slot->low) ? OutputDutyCycle_MAX : OutputDutyCycle_MIN;
+
+  int32_t highCycle = (int32_t)(slot->high - temp) * OutputDutyCycle_STEPS / range;
+  return constrain(highCycle, OutputDutyCycle_MIN, OutputDutyCycle_MAX);
+}
+
+// Ticks of task_temperature conversion takes, with one tick to spare
+uint8_t conversionTicks(uint8_t resolution)
+{
+  uint16_t conversionMs = TempSensor_CONVERSION_MAX >> (TempSensor_RES_MAX - resolution);
+  return conversionMs / Task_TEMPERATURE_MS + 1;
+}
+
+#ifndef nanods_NORES
+// Resolution of the next conversion
+uint8_t sensorResolution(TempControlSlot *slot, int16_t temp)
+{
+#ifdef TempControl_PID
+  if (tempControlPidSlots & (1 << tempControlCurrentSlot))
+    return TempSensor_RES_MAX;
+#endif
+
+  int16_t bottom = min(slot->low, slot->high);
+  int16_t top = max(slot->low, slot->high);
+  int16_t distance = 0;
+  if (temp < bottom)
+    distance = bottom - temp;
+  if (temp > top)
+    distance = temp - top;
+
+  if (distance == 0)
+    return TempSensor_RES_MAX;
+  if (distance <= TempSensor_NEAR)
+    return TempSensor_RES_MAX - 1;
+  if (distance <= TempSensor_FAR)
+    return TempSensor_RES_MIN + 1;
+  return TempSensor_RES_MIN;
+}
+
+// Called between conversions only, when the bus is free
+void setSensorsResolution()
+{
+  for (uint8_t sensorNum = 0; sensorNum < tempSensorsCount; sensorNum++)
+    microds_setResolution(&tempSensors[sensorNum], tempSensorNextResolution);
+  tempSensorResolution = tempSensorNextResolution;
+  tempUpdateWait = conversionTicks(tempSensorResolution);
+}
+
+// Sensor which lost power or was replaced is back at 12 bits
+// with 85 C in its scratchpad, and a shorter wait reads that instead
+// of the conversion. Such reading, coming from far away, is dropped.
+// After it, or after a failed read, resolution is sent again
+// before the next conversion.
+#define TempSensor_POWER_ON 850 // temp*10
+
+bool checkSensorReading(bool read, int16_t temp)
+{
+  if (read && (temp != TempSensor_POWER_ON || tempSensorResolution == TempSensor_RES_MAX ||
+               (temp - tempUpdatePrev <= TempSensor_NEAR && tempUpdatePrev - temp <= TempSensor_NEAR)))
+    return true;
+  tempSensorResolution = 0;
+  return false;
+}
+#else
+#define checkSensorReading(read, temp) (read)
+#endif
+
+// Set output duty cycle for the new temperature and show it
+void applyTemperature(int16_t reading)
+{
+  TempControlSlot *slot = currentTempSlot();
+  int16_t temp = reading;
+#ifdef TempSensor_LAG_FILTER
+  if (tempSensorLag)
+    temp = lagfilter_update(&tempSensorFilter, reading, min(millis() - tempUpdateTime, UINT16_MAX));
+  tempUpdateTime = millis();
+#endif
+
+#ifdef TempControl_AUTOTUNE
+  if (menuState == MenuState_AUTOTUNE)
+    slowpwm_setHigh(&output, autotuneDutyCycle(slot, reading));
+  else
+#endif
+#ifdef TempControl_PID
+  if (tempControlPidSlots & (1 << tempControlCurrentSlot))
+    slowpwm_setHigh(&output, pidDutyCycle(slot, reading));
+  else
+#endif
+    slowpwm_setHigh(&output, linearDutyCycle(slot, temp));
+
+#ifndef nanods_NORES
+  tempSensorNextResolution = sensorResolution(slot, reading);
+#endif
+  tempUpdatePrev = reading;
+  displayTemperature();
+}
+
 void updateTemperature()
 {
+#ifdef nanods_ASYNC
+  if (microds_poll(&tempSensors[tempReadSensor]) == ONEWIRE_BUSY)
+    return;
+#endif
+
+  // conversion is started on all sensors at once
   if (tempUpdateStep == TempUpdate_READY)
   {
-    microds_requestTemp(&tempSensor);
+    profileOneWire_begin();
+#ifndef nanods_NORES
+    if (tempSensorResolution != tempSensorNextResolution)
+      setSensorsResolution();
+#endif
+#ifdef nanods_ASYNC
+    microds_startRequest(&tempSensors[0]);
+#else
+    microds_requestTemp(&tempSensors[0]);
+#endif
+    profileOneWire_end();
     tempUpdateStep++;
     return;
   }
 
   tempUpdateStep++;
-  if (tempUpdateStep > TempUpdate_TIMEOUT)
+  if (tempUpdateStep <= tempUpdateWait)
+    return;
+  if (tempUpdateStep > tempUpdateWait + TempUpdate_TIMEOUT)
   {
     tempUpdateStep = TempUpdate_READY;
     return;
   }
 
-  if (!microds_readTemp(&tempSensor))
+#ifdef nanods_ASYNC
+  // result is taken by pollTemperature
+  tempReadSensor = 0;
+  tempReadCount = 0;
+  tempReadSum = 0;
+  microds_startRead(&tempSensors[0]);
+#else
+  uint8_t readCount = 0;
+  int16_t readSum = 0;
+  profileOneWire_begin();
+  for (uint8_t sensorNum = 0; sensorNum < tempSensorsCount; sensorNum++)
+  {
+    bool read = microds_readTemp(&tempSensors[sensorNum]);
+    int16_t temp = microds_getTemp10(&tempSensors[sensorNum]);
+    if (!checkSensorReading(read, temp))
+      continue;
+    readSum += temp;
+    readCount++;
+  }
+  profileOneWire_end();
+  if (readCount == 0)
     return;
 
   tempUpdateStep = false;
-  float temp = microds_getTemp(&tempSensor);
+  applyTemperature(readSum / readCount);
+#endif
+}
 
-  TempControlSlot *slot = currentTempSlot();
+#ifdef nanods_ASYNC
+// Apply temperature as soon as background read is over
+void pollTemperature()
+{
+  uint8_t state = microds_poll(&tempSensors[tempReadSensor]);
+  // request is done first, read is started after conversion
+  if ((state != ONEWIRE_DONE && state != ONEWIRE_NO_DEVICE) || tempUpdateStep <= tempUpdateWait)
+    return;
 
-  // if range is zero or greater,
-  // output will be turned OFF when temp rises (heating mode)
-  // if range is less than zero,
-  // output will be turned ON when temp rises (cooling mode)
-  float diff = (slot->low / 10.0) - temp;
-  float range = (slot->high - slot->low) / 10.0;
-  float outputDutyCycle = 1 + (diff / range);
-  outputHighCycleDuration = outputDutyCycle * OutputDutyCycle_DURATION;
+  int16_t temp = microds_getTemp10(&tempSensors[tempReadSensor]);
+  if (checkSensorReading(state == ONEWIRE_DONE, temp))
+  {
+    tempReadSum += temp;
+    tempReadCount++;
+  }
+  if (tempReadSensor + 1 < tempSensorsCount)
+  {
+    tempReadSensor++;
+    microds_startRead(&tempSensors[tempReadSensor]);
+    return;
+  }
 
-  tempUpdatePrev = temp;
-  displayTemperature();
+  tempReadSensor = 0;
+  // nothing was read, updateTemperature tries again
+  if (tempReadCount == 0)
+    return;
+
+  tempUpdateStep = TempUpdate_READY;
+  applyTemperature(tempReadSum / tempReadCount);
 }
+#endif
+
+#ifdef Button_INTERRUPT
+// Take events of both buttons, hold timing is done by Buttons
+void readButtonEvents()
+{
+  buttons_update();
 
+  Event event;
+  while (buttons_next(&event))
+  {
+    Button *button = (event.source == 0) ? &buttonUp : &buttonDown;
+    if (event.type == BUTTONS_HOLD)
+    {
+      button->held = true;
+      continue;
+    }
+
+    button->pressed = (event.type == BUTTONS_PRESS);
+    button->changed = true;
+    // tap may be released before events are taken, click stays
+    if (button->pressed)
+      button->clicked = true;
+    if (button->pressed && menuActiveCounter == 0)
+      menuActiveCounter++;
+  }
+}
+
+void handleButtonClick(Button *button, ButtonClick *click)
+{
+  click->pressed = button->pressed;
+  if (button->changed)
+  {
+    button->changed = false;
+    button->held = false;
+    click->once = button->clicked;
+    button->clicked = false;
+  }
+  else if (button->held)
+  {
+    button->held = false;
+    click->hold = click->pressed;
+  }
+}
+#else
 void readButton(Button *button)
 {
   bool btnPressed = !digitalRead(button->pin);
@@ -298,8 +835,7 @@ void handleButtonClick(Button *button, ButtonClick *click)
   {
     if (click->pressed)
     {
-      if (isNthIteration(10))
-        button->timer++;
+      // timer is counted by task_buttonHold
       if (button->timer > 125)
       {
         button->timer = 100;
@@ -308,6 +844,7 @@ void handleButtonClick(Button *button, ButtonClick *click)
     }
   }
 }
+#endif
 
 void displayMenu_setTemperature(ButtonClick *upClick, ButtonClick *downClick, int16_t *temp)
 {
@@ -326,29 +863,146 @@ void displayMenu_setTemperature(ButtonClick *upClick, ButtonClick *downClick, in
   if (*temp < TempControl_MIN_TEMP)
     *temp = TempControl_MIN_TEMP;
 
-  displayFlashingNumber(*temp / 10.0, false);
+  displayFlashingNumber(*temp, false);
 
+  // only the slot being set is written, if it changed
   if (menuActiveCounter == 1)
-    EEPROM_put(10, tempControlSlots);
+    settingslog_write(&settings, tempControlCurrentSlot, currentTempSlot(), sizeof(TempControlSlot));
+}
+
+#ifdef TempControl_PID
+// Holding both buttons switches mode of the current slot,
+// once until they are released. Return true if both are held.
+// Modes go in order linear, PID, PID with relay test (if enabled).
+bool displayMenu_switchSlotMode(ButtonClick *upClick, ButtonClick *downClick)
+{
+  if (!upClick->pressed || !downClick->pressed)
+  {
+    tempControlPidSwitched = false;
+    return false;
+  }
+
+  if ((upClick->hold || downClick->hold) && !tempControlPidSwitched)
+  {
+#ifdef TempControl_AUTOTUNE
+    tempControlTunePending = !tempControlTunePending && (tempControlPidSlots & (1 << tempControlCurrentSlot));
+    if (!tempControlTunePending)
+#endif
+      tempControlPidSlots ^= 1 << tempControlCurrentSlot;
+    tempControlPidSwitched = true;
+    pid_reset(&pid);
+  }
+  return true;
+}
+#endif
+
+void saveSlotMenu()
+{
+  settingslog_write(&settings, TempControl_KEY_CURRENT_SLOT, &tempControlCurrentSlot, sizeof(tempControlCurrentSlot));
+#ifdef TempControl_PID
+  settingslog_write(&settings, TempControl_KEY_PID_SLOTS, &tempControlPidSlots, sizeof(tempControlPidSlots));
+#endif
 }
 
 void displayMenu_setSlot(ButtonClick *upClick, ButtonClick *downClick)
 {
-  if (upClick->once || upClick->hold)
-    tempControlCurrentSlot += 1;
+#ifdef TempControl_PID
+  uint8_t prevSlot = tempControlCurrentSlot;
 
-  if (downClick->once || downClick->hold)
-    tempControlCurrentSlot -= (tempControlCurrentSlot > 0 ? 1 : sizeof(tempControlCurrentSlot) - TempControl_SLOTS_COUNT);
+  if (!displayMenu_switchSlotMode(upClick, downClick))
+#endif
+  {
+#ifdef SCHEDULER_PROFILE
+    if ((upClick->once || upClick->hold) && tempControlCurrentSlot == TempControl_SLOTS_COUNT - 1)
+    {
+      // slot is saved now, profile menu is closed without it
+      saveSlotMenu();
+      menuState = MenuState_PROFILE;
+      menuProfilePage = 0;
+      return;
+    }
+#endif
+    if (upClick->once || upClick->hold)
+      tempControlCurrentSlot += 1;
 
-  if (tempControlCurrentSlot >= TempControl_SLOTS_COUNT)
-    tempControlCurrentSlot = 0;
+    if (downClick->once || downClick->hold)
+      tempControlCurrentSlot -= (tempControlCurrentSlot > 0 ? 1 : sizeof(tempControlCurrentSlot) - TempControl_SLOTS_COUNT);
+
+    if (tempControlCurrentSlot >= TempControl_SLOTS_COUNT)
+      tempControlCurrentSlot = 0;
+  }
+
+#ifdef TempControl_PID
+  if (tempControlCurrentSlot != prevSlot)
+  {
+    pid_reset(&pid);
+#ifdef TempControl_AUTOTUNE
+    tempControlTunePending = false;
+#endif
+  }
 
-  displayFlashingNumber(tempControlCurrentSlot + 1, true);
+#ifdef TempControl_AUTOTUNE
+  if (tempControlTunePending)
+    displayFlashingNumber(-(tempControlCurrentSlot + 1), true);
+  else
+#endif
+  // slots in PID mode are shown with decimal place, i.e. "2.0"
+  if (tempControlPidSlots & (1 << tempControlCurrentSlot))
+    displayFlashingNumber((tempControlCurrentSlot + 1) * 10, false);
+  else
+#endif
+    displayFlashingNumber(tempControlCurrentSlot + 1, true);
 
   if (menuActiveCounter == 1)
-    EEPROM_put(TempControl_EEPROM_CURRENT_SLOT_ADDR, tempControlCurrentSlot);
+    saveSlotMenu();
 }
 
+#ifdef SCHEDULER_PROFILE
+// overruns are counted in iterations, the rest in us
+uint16_t profilePageValue(uint8_t page)
+{
+  if (page == 0)
+    return scheduler.overruns;
+  if (page == 1)
+    return scheduler.busy.max;
+  if (page == 2)
+    return profileOneWire.max;
+  return scheduler.tasks[page - 3].profile.max;
+}
+
+void displayMenu_profile(ButtonClick *upClick, ButtonClick *downClick)
+{
+  if (upClick->once || upClick->hold)
+  {
+    menuProfilePage++;
+    if (menuProfilePage >= 3 + scheduler.numTasks)
+      menuProfilePage = 0;
+  }
+
+  if (downClick->once || downClick->hold)
+  {
+    if (menuProfilePage == 0)
+    {
+      menuState = MenuState_SET_SLOT;
+      return;
+    }
+    menuProfilePage--;
+  }
+
+  if (menuActiveCounter > MenuActive_MAX - MenuProfile_LABEL_TIME)
+  {
+    displayNumber(-(menuProfilePage + 1), true);
+    return;
+  }
+
+  uint16_t value = profilePageValue(menuProfilePage);
+  if (menuProfilePage == 0 || value < 1000)
+    displayNumber(value > 999 ? 999 : value, true);
+  else
+    displayNumber(value / 100, false);
+}
+#endif
+
 void displayMenu_dispatcher()
 {
   ButtonClick upClick = {false, false, false};
@@ -356,18 +1010,17 @@ void displayMenu_dispatcher()
   handleButtonClick(&buttonUp, &upClick);
   handleButtonClick(&buttonDown, &downClick);
 
-  if (!upClick.once && !downClick.once && !upClick.hold && !downClick.hold)
+#ifdef TempControl_AUTOTUNE
+  // any button stops relay test, PID keeps gains it had
+  if (menuState == MenuState_AUTOTUNE)
   {
-    if (isNthIteration(100) && menuActiveCounter > 0)
-      menuActiveCounter--;
-    if (menuActiveCounter == 0)
-    {
-      menuState = MenuState_DEFAULT;
-      displayTemperature();
-      return;
-    }
+    menuState = MenuState_DEFAULT;
+    pid_reset(&pid);
   }
-  else
+#endif
+
+  // without user input menu is closed by task_menuDecay
+  if (upClick.once || downClick.once || upClick.hold || downClick.hold)
   {
     menuActiveCounter = MenuActive_MAX;
   }
@@ -387,21 +1040,32 @@ void displayMenu_dispatcher()
     displayMenu_setSlot(&upClick, &downClick);
     return;
   }
+#ifdef SCHEDULER_PROFILE
+  if (menuState == MenuState_PROFILE)
+  {
+    displayMenu_profile(&upClick, &downClick);
+    return;
+  }
+#endif
 
   if (upClick.pressed && downClick.pressed && menuState == MenuState_SHOW_TEMP)
   {
     menuState = MenuState_SET_SLOT;
+#ifdef TempControl_PID
+    // buttons must be released, before they can switch slot mode
+    tempControlPidSwitched = true;
+#endif
     return;
   }
 
   if (upClick.once)
   {
-    displayNumber(currentTempSlot()->high / 10.0, false);
+    displayNumber(currentTempSlot()->high, false);
     menuState = MenuState_SHOW_TEMP;
   }
   else if (downClick.once)
   {
-    displayNumber(currentTempSlot()->low / 10.0, false);
+    displayNumber(currentTempSlot()->low, false);
     menuState = MenuState_SHOW_TEMP;
   }
   else if (upClick.hold)
@@ -414,46 +1078,190 @@ void displayMenu_dispatcher()
   }
 }
 
-void loop()
+void task_refreshDisplay()
 {
-  // this isn't precise and don't had to be
-  int16_t sleepTime = ITERATION_DURATION - (micros() - prevIterationStart);
-  if (sleepTime > 20)
+  sevseg_refreshDisplay(&display);
+}
+
+void task_input()
+{
+#ifdef Button_INTERRUPT
+  readButtonEvents();
+#else
+  readButton(&buttonUp);
+  readButton(&buttonDown);
+#endif
+
+  if (menuActiveCounter > 0)
+  {
+    displayMenu_dispatcher();
+  }
+#ifdef nanods_ASYNC
+  else
   {
-    delayMicroseconds(sleepTime);
+    pollTemperature();
   }
-  prevIterationStart = micros();
-  currentIteration++;
+#endif
+}
 
-  if (isNthIteration(5))
+void task_temperature()
+{
+  if (menuActiveCounter == 0)
+    updateTemperature();
+}
+
+#ifndef Button_INTERRUPT
+void task_buttonHold()
+{
+  if (buttonUp.counter > Button_THRESHOLD)
+    buttonUp.timer++;
+  if (buttonDown.counter > Button_THRESHOLD)
+    buttonDown.timer++;
+}
+#endif
+
+void task_menuDecay()
+{
+  if (menuActiveCounter == 0)
+    return;
+
+  menuActiveCounter--;
+  if (menuActiveCounter == 0)
   {
-    sevseg_refreshDisplay(&display);
+    menuState = MenuState_DEFAULT;
+#ifdef TempControl_AUTOTUNE
+    if (tempControlTunePending)
+    {
+      tempControlTunePending = false;
+      startAutotune();
+    }
+#endif
+    displayTemperature();
   }
+}
+
+// Called from TIM2 interrupt with Output_TIMER defined
+void task_output()
+{
+  slowpwm_step(&output);
+}
 
-  // do nothing (display all segments) on startup or move on overflow
-  if (currentIteration < 1000)
+#ifdef Telemetry_UART
+void task_telemetry()
+{
+  TelemetryFrame frame;
+  TempControlSlot *slot = currentTempSlot();
+  frame.time = millis();
+  frame.raw = tempSensors[0]._buf;
+  frame.low = slot->low;
+  frame.high = slot->high;
+  frame.duty = output.high;
+  frame.state = tempControlCurrentSlot & TELEMETRY_SLOT_MASK;
+  if (output.on)
+    frame.state |= TELEMETRY_OUTPUT_ON;
+
+  uint8_t bytes[TELEMETRY_FRAME_SIZE];
+  telemetry_encode(&frame, bytes);
+  uart_write(bytes, TELEMETRY_FRAME_SIZE);
+}
+#endif
+
+#ifdef Modbus_RTU
+uint8_t modbusRead(uint8_t function, uint16_t address, uint16_t *value)
+{
+  if (function == MODBUS_READ_INPUT)
   {
-    if (currentIteration == 0)
-      currentIteration = 1000;
-    return;
+    if (address == 0)
+      *value = tempUpdatePrev;
+    else if (address == 1)
+      *value = output.high;
+    else if (address == 2)
+      *value = output.on;
+#ifdef SCHEDULER_PROFILE
+    else if (address >= Modbus_PROFILE_ADDR && address < Modbus_PROFILE_ADDR + 3 + scheduler.numTasks)
+      *value = profilePageValue(address - Modbus_PROFILE_ADDR);
+#endif
+    else
+      return MODBUS_ILLEGAL_ADDRESS;
+    return 0;
   }
 
-  readButton(&buttonUp);
-  readButton(&buttonDown);
+  if (address == 0)
+  {
+    *value = tempControlCurrentSlot;
+    return 0;
+  }
+  address--;
+  if (address >= TempControl_SLOTS_COUNT * 2)
+    return MODBUS_ILLEGAL_ADDRESS;
+  TempControlSlot *slot = &tempControlSlots[address >> 1];
+  *value = (address & 1) ? slot->high : slot->low;
+  return 0;
+}
 
-  if (menuActiveCounter > 0)
+uint8_t modbusWrite(uint16_t address, uint16_t value, bool apply)
+{
+  int16_t temp = (int16_t)value;
+  if (address == 0)
   {
-    displayMenu_dispatcher();
+    if (value >= TempControl_SLOTS_COUNT)
+      return MODBUS_ILLEGAL_VALUE;
+    if (!apply)
+      return 0;
+#ifdef TempControl_PID
+    if (value != tempControlCurrentSlot)
+      pid_reset(&pid);
+#endif
+    tempControlCurrentSlot = value;
+    modbusUnsaved |= Modbus_UNSAVED_CURRENT_SLOT;
   }
-  else if (isNthIteration(1000)) // every 200ms
+  else
   {
-    updateTemperature();
+    address--;
+    if (address >= TempControl_SLOTS_COUNT * 2)
+      return MODBUS_ILLEGAL_ADDRESS;
+    if (temp > TempControl_MAX_TEMP || temp < TempControl_MIN_TEMP)
+      return MODBUS_ILLEGAL_VALUE;
+    if (!apply)
+      return 0;
+    TempControlSlot *slot = &tempControlSlots[address >> 1];
+    if (address & 1)
+      slot->high = temp;
+    else
+      slot->low = temp;
+    modbusUnsaved |= 1 << (address >> 1);
   }
 
-  if (isNthIteration(10))
+#ifdef TempControl_AUTOTUNE
+  tempControlTunePending = false;
+  if (menuState == MenuState_AUTOTUNE)
   {
-    uint32_t cycleIteration = currentIteration % OutputDutyCycle_DURATION;
-    bool outputOn = (cycleIteration < outputHighCycleDuration);
-    digitalWrite(outputPin, outputOn ? OutputLevel_ON : OutputLevel_OFF);
+    menuState = MenuState_DEFAULT;
+    pid_reset(&pid);
   }
+#endif
+  return 0;
+}
+
+// Answer is on its way when settings are written,
+// so EEPROM does not delay it
+void task_modbus()
+{
+  if (!modbus_poll() || !modbusUnsaved)
+    return;
+
+  if (modbusUnsaved & Modbus_UNSAVED_CURRENT_SLOT)
+    settingslog_write(&settings, TempControl_KEY_CURRENT_SLOT, &tempControlCurrentSlot, sizeof(tempControlCurrentSlot));
+  for (uint8_t slotNum = 0; slotNum < TempControl_SLOTS_COUNT; slotNum++)
+  {
+    if (modbusUnsaved & (1 << slotNum))
+      settingslog_write(&settings, slotNum, &tempControlSlots[slotNum], sizeof(TempControlSlot));
+  }
+  modbusUnsaved = 0;
+}
+#endif
+
+void loop()
+{
+  scheduler_run(&scheduler);
 }
@@ -0,0 +1,240 @@
+// Modbus RTU master for regulators with Modbus_RTU build:
+// reads and writes registers over serial device or pty,
+// one request at a time, and prints answers and round trip times.
+//
+// usage: modbus [-b baud] device slave operation...
+//   r:ADDRESS[:COUNT]      read holding registers
+//   i:ADDRESS[:COUNT]      read input registers
+//   w:ADDRESS:VALUE        write single register
+//   W:ADDRESS:VALUE,...    write multiple registers
+// Values are signed decimal (temperatures are temp*10).
+// Exit code is 1 if any answer timed out or was broken,
+// exception answers are printed, but are not errors.
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+#define MASTER_TIMEOUT_MS 1000
+#define MASTER_MAX_REGISTERS 123
+
+static int line;
+
+static uint16_t crc16(const uint8_t *data, size_t size)
+{
+    uint16_t crc = 0xFFFF;
+    while (size--)
+    {
+        crc ^= *data++;
+        for (int bit = 0; bit < 8; bit++)
+            crc = (crc & 1) ? (crc >> 1) ^ 0xA001 : crc >> 1;
+    }
+    return crc;
+}
+
+static double clockMs(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1e6;
+}
+
+static speed_t baudSpeed(long baud)
+{
+    switch (baud)
+    {
+    case 1200: return B1200;
+    case 2400: return B2400;
+    case 4800: return B4800;
+    case 19200: return B19200;
+    case 38400: return B38400;
+    case 57600: return B57600;
+    case 115200: return B115200;
+    default: return B9600;
+    }
+}
+
+// Read exactly size bytes, false on timeout
+static bool readBytes(uint8_t *data, size_t size, double deadline)
+{
+    while (size)
+    {
+        struct pollfd wait = {line, POLLIN, 0};
+        int left = (int)(deadline - clockMs());
+        if (left <= 0 || poll(&wait, 1, left) <= 0)
+            return false;
+        ssize_t got = read(line, data, size);
+        if (got <= 0)
+            return false;
+        data += got;
+        size -= got;
+    }
+    return true;
+}
+
+// Send request (CRC is added), read answer into 'answer',
+// return its size, 0 on timeout, -1 on broken answer
+static int transact(uint8_t *request, size_t size, uint8_t *answer)
+{
+    uint16_t crc = crc16(request, size);
+    request[size++] = (uint8_t)crc;
+    request[size++] = (uint8_t)(crc >> 8);
+    tcflush(line, TCIFLUSH);
+    if (write(line, request, size) != (ssize_t)size)
+        return 0;
+
+    double deadline = clockMs() + MASTER_TIMEOUT_MS;
+    if (!readBytes(answer, 3, deadline))
+        return 0;
+    size_t total;
+    if (answer[1] & 0x80)
+        total = 5;
+    else if (answer[1] == 3 || answer[1] == 4)
+        total = 5 + answer[2];
+    else
+        total = 8;
+    if (!readBytes(answer + 3, total - 3, deadline))
+        return 0;
+    if (answer[0] != request[0] || (answer[1] & 0x7F) != request[1] ||
+        crc16(answer, total - 2) != (answer[total - 2] | (answer[total - 1] << 8)))
+        return -1;
+    return (int)total;
+}
+
+static bool run(uint8_t slave, const char *operation)
+{
+    uint8_t request[8 + 2 * MASTER_MAX_REGISTERS];
+    uint8_t answer[8 + 2 * MASTER_MAX_REGISTERS];
+    char kind = operation[0];
+    long address = 0, count = 1;
+    const char *values = NULL;
+    if (sscanf(operation, "%*c:%ld", &address) != 1 || address < 0 || address > 0xFFFF)
+    {
+        printf("%s: bad operation\n", operation);
+        return false;
+    }
+    const char *rest = strchr(operation + 2, ':');
+    if (rest)
+        values = rest + 1;
+
+    size_t size = 0;
+    request[size++] = slave;
+    if (kind == 'r' || kind == 'i')
+    {
+        if (values)
+            count = strtol(values, NULL, 10);
+        if (count < 1 || count > MASTER_MAX_REGISTERS)
+            count = 1;
+        request[size++] = kind == 'r' ? 3 : 4;
+        request[size++] = address >> 8;
+        request[size++] = address;
+        request[size++] = count >> 8;
+        request[size++] = count;
+    }
+    else if (kind == 'w' && values)
+    {
+        long value = strtol(values, NULL, 10);
+        request[size++] = 6;
+        request[size++] = address >> 8;
+        request[size++] = address;
+        request[size++] = value >> 8;
+        request[size++] = value;
+    }
+    else if (kind == 'W' && values)
+    {
+        request[size++] = 16;
+        request[size++] = address >> 8;
+        request[size++] = address;
+        size += 3; // count and byte count
+        count = 0;
+        char *next = (char *)values;
+        while (*next && count < MASTER_MAX_REGISTERS)
+        {
+            long value = strtol(next, &next, 10);
+            request[size++] = value >> 8;
+            request[size++] = value;
+            count++;
+            if (*next == ',')
+                next++;
+            else
+                break;
+        }
+        request[4] = count >> 8;
+        request[5] = count;
+        request[6] = count * 2;
+    }
+    else
+    {
+        printf("%s: bad operation\n", operation);
+        return false;
+    }
+
+    double start = clockMs();
+    int got = transact(request, size, answer);
+    double took = clockMs() - start;
+    printf("%s:", operation);
+    if (got <= 0)
+    {
+        printf(" %s\n", got ? "broken answer" : "timeout");
+        return false;
+    }
+    if (answer[1] & 0x80)
+        printf(" exception %d", answer[2]);
+    else if (kind == 'r' || kind == 'i')
+        for (int i = 0; i < answer[2] / 2; i++)
+            printf(" %d", (int16_t)((answer[3 + i * 2] << 8) | answer[4 + i * 2]));
+    else
+        printf(" ok");
+    printf("  (%.1f ms)\n", took);
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    long baud = 9600;
+    int arg = 1;
+    if (argc > 2 && !strcmp(argv[1], "-b"))
+    {
+        baud = strtol(argv[2], NULL, 10);
+        arg = 3;
+    }
+    if (argc - arg < 3)
+    {
+        fprintf(stderr, "usage: %s [-b baud] device slave operation...\n", argv[0]);
+        return 2;
+    }
+
+    line = open(argv[arg], O_RDWR | O_NOCTTY);
+    if (line < 0)
+    {
+        perror(argv[arg]);
+        return 1;
+    }
+    struct termios tio;
+    if (!tcgetattr(line, &tio))
+    {
+        cfmakeraw(&tio);
+        cfsetispeed(&tio, baudSpeed(baud));
+        cfsetospeed(&tio, baudSpeed(baud));
+        tio.c_cflag |= CLOCAL | CREAD;
+        tcsetattr(line, TCSANOW, &tio);
+    }
+
+    uint8_t slave = (uint8_t)strtol(argv[arg + 1], NULL, 10);
+    bool ok = true;
+    for (int i = arg + 2; i < argc; i++)
+    {
+        ok = run(slave, argv[i]) && ok;
+        // 3.5 characters of silence before the next request
+        usleep(5000);
+    }
+    close(line);
+    return !ok;
+}
@@ -0,0 +1,125 @@
+// Decoder of telemetry frames (see lib/Telemetry/Telemetry.h):
+// reads serial device or pty and writes CSV to stdout,
+// count of frames and of skipped bytes to stderr at the end.
+// Runs until the device is closed on the other end (or Ctrl+C).
+//
+// usage: telemetry device [baud], baud is 9600 by default
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <termios.h>
+#include <unistd.h>
+#include <Telemetry.h>
+
+static volatile sig_atomic_t stopped;
+
+static void stop(int signal)
+{
+    (void)signal;
+    stopped = 1;
+}
+
+static speed_t baudSpeed(long baud)
+{
+    switch (baud)
+    {
+    case 1200: return B1200;
+    case 2400: return B2400;
+    case 4800: return B4800;
+    case 19200: return B19200;
+    case 38400: return B38400;
+    case 57600: return B57600;
+    case 115200: return B115200;
+    default: return B9600;
+    }
+}
+
+// Raw bytes, no echo and no line editing, reads wait for one byte
+static void setRaw(int fd, long baud)
+{
+    struct termios tio;
+    if (tcgetattr(fd, &tio))
+        return;
+    cfmakeraw(&tio);
+    cfsetispeed(&tio, baudSpeed(baud));
+    cfsetospeed(&tio, baudSpeed(baud));
+    tio.c_cflag |= CLOCAL | CREAD;
+    tio.c_cc[VMIN] = 1;
+    tio.c_cc[VTIME] = 0;
+    tcsetattr(fd, TCSANOW, &tio);
+}
+
+static void printFrame(const TelemetryFrame *frame)
+{
+    printf("%u,%.4f,%.1f,%.1f,%u,%d,%d\n",
+           frame->time,
+           frame->raw / 16.0,
+           frame->low / 10.0,
+           frame->high / 10.0,
+           frame->duty,
+           (frame->state & TELEMETRY_OUTPUT_ON) ? 1 : 0,
+           (frame->state & TELEMETRY_SLOT_MASK) + 1);
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 2)
+    {
+        fprintf(stderr, "usage: %s device [baud]\n", argv[0]);
+        return 2;
+    }
+    int fd = open(argv[1], O_RDONLY | O_NOCTTY);
+    if (fd < 0)
+    {
+        perror(argv[1]);
+        return 1;
+    }
+    if (isatty(fd))
+        setRaw(fd, argc > 2 ? strtol(argv[2], NULL, 10) : 9600);
+
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = stop;
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+
+    printf("time_ms,temperature,low,high,duty,output,slot\n");
+    uint8_t buffer[256];
+    size_t count = 0;
+    unsigned long frames = 0, skipped = 0;
+    while (!stopped)
+    {
+        // pty returns error instead of end of file when closed
+        ssize_t got = read(fd, buffer + count, sizeof(buffer) - count);
+        if (got <= 0)
+            break;
+        count += got;
+
+        size_t start = 0;
+        while (count - start >= TELEMETRY_FRAME_SIZE)
+        {
+            TelemetryFrame frame;
+            if (telemetry_decode(buffer + start, &frame))
+            {
+                printFrame(&frame);
+                frames++;
+                start += TELEMETRY_FRAME_SIZE;
+            }
+            else
+            {
+                skipped++;
+                start++;
+            }
+        }
+        memmove(buffer, buffer + start, count - start);
+        count -= start;
+        fflush(stdout);
+    }
+
+    fprintf(stderr, "%lu frames, %lu bytes skipped\n", frames, skipped + count);
+    close(fd);
+    return 0;
+}